@@ -0,0 +1,331 @@
+#pragma once
+#include <cstddef>
+
+#ifdef ADAPTIVECARDS_ALLOC_TRACKING
+#ifdef RAPIDJSON_RAPIDJSON_H_
+#error "adaptivecards-alloc.h must come before any rapidjson header, or DOM allocations go untracked"
+#endif
+namespace AdaptiveCards
+{
+    void *tracked_malloc(size_t size);
+    void *tracked_realloc(void *ptr, size_t size);
+    void tracked_free(void *ptr);
+}
+
+// rapidjson's CrtAllocator goes through these, so DOM and parse stacks are counted too.
+#define RAPIDJSON_MALLOC(size) ::AdaptiveCards::tracked_malloc(size)
+#define RAPIDJSON_REALLOC(ptr, new_size) ::AdaptiveCards::tracked_realloc(ptr, new_size)
+#define RAPIDJSON_FREE(ptr) ::AdaptiveCards::tracked_free(ptr)
+#endif
+
+#include "adaptivecards-trace.h"
+
+#ifdef ADAPTIVECARDS_ALLOC_TRACKING
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <list>
+#include <map>
+#include <mutex>
+#include <new>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "rapidjson/ostreamwrapper.h"
+#include "rapidjson/writer.h"
+
+namespace AdaptiveCards
+{
+    struct AllocCounter {
+        uint64_t count{0};
+        uint64_t bytes{0};
+    };
+
+    // Allocation totals by phase (index Phase::Count collects allocations made outside
+    // any phase) and by the element type whose factory was running, plus the bytes of
+    // those allocations not freed yet.
+    struct AllocReport {
+        std::array<AllocCounter, static_cast<size_t>(Phase::Count) + 1> phases{};
+        std::vector<std::pair<const char *, AllocCounter>> elements;
+        int64_t live_bytes{0};
+    };
+
+    // Allocation counts by phase and by element type, for the whole process or for one card.
+    class AllocCounters {
+        struct Counter {
+            std::atomic<uint64_t> count{0};
+            std::atomic<uint64_t> bytes{0};
+
+            void Add(size_t size) {
+                count.fetch_add(1, std::memory_order_relaxed);
+                bytes.fetch_add(size, std::memory_order_relaxed);
+            }
+            AllocCounter Load() const {
+                return {count.load(std::memory_order_relaxed), bytes.load(std::memory_order_relaxed)};
+            }
+        };
+
+        struct ElementSlot {
+            std::atomic<const char *> name{nullptr};
+            Counter counter;
+        };
+
+        static constexpr size_t element_slots {64};
+
+        std::array<Counter, static_cast<size_t>(Phase::Count) + 1> phases_;
+        std::array<ElementSlot, element_slots> elements_;
+        std::atomic<int64_t> live_bytes_{0};
+
+    public:
+        void Account(size_t size, Phase phase, const char *element) {
+            phases_[static_cast<size_t>(phase)].Add(size);
+            if (!element) {
+                return;
+            }
+            auto const hash {reinterpret_cast<uintptr_t>(element) / alignof(char *)};
+            for (size_t probe = 0; probe < element_slots; ++probe) {
+                auto &slot {elements_[(hash + probe) % element_slots]};
+                auto name {slot.name.load(std::memory_order_acquire)};
+                if (!name && slot.name.compare_exchange_strong(name, element, std::memory_order_acq_rel)) {
+                    name = element;
+                }
+                if (name == element) {
+                    slot.counter.Add(size);
+                    return;
+                }
+            }
+        }
+
+        void Live(int64_t bytes) {
+            live_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+        }
+
+        AllocReport Snapshot() const {
+            AllocReport report;
+            for (size_t i = 0; i < phases_.size(); ++i) {
+                report.phases[i] = phases_[i].Load();
+            }
+            for (auto const &slot: elements_) {
+                if (auto const name {slot.name.load(std::memory_order_acquire)}) {
+                    report.elements.emplace_back(name, slot.counter.Load());
+                }
+            }
+            report.live_bytes = live_bytes_.load(std::memory_order_relaxed);
+            return report;
+        }
+    };
+
+    class AllocTracker {
+        struct Context {
+            Phase phase{Phase::Count};
+            const char *element{nullptr};
+            // The card whose widgets are being built on this thread, if any.
+            AllocCounters *card{nullptr};
+        };
+
+        // Every block carries its size and card in front, so frees come off the live bytes
+        // of the card that allocated it.
+        struct Header {
+            size_t size;
+            AllocCounters *card;
+        };
+        static constexpr size_t header {alignof(std::max_align_t)};
+        static_assert(sizeof(Header) <= header);
+
+        AllocCounters total_;
+        std::mutex cards_mutex_;
+        // Never shrinks: blocks of a card may outlive its report. A list, since constructing
+        // the tracker must not allocate.
+        std::list<AllocCounters> cards_;
+
+        // Integer arithmetic, so the compiler cannot pair the header with the object a
+        // replaced operator new handed out and warn about bounds or a mismatched free.
+        static Header *header_of(void *ptr) {
+            return reinterpret_cast<Header *>(reinterpret_cast<uintptr_t>(ptr) - header);
+        }
+
+        void *Place(void *raw, size_t size) {
+            auto const &current {context()};
+            *static_cast<Header *>(raw) = {size, current.card};
+            total_.Live(static_cast<int64_t>(size));
+            total_.Account(size, current.phase, current.element);
+            if (current.card) {
+                current.card->Live(static_cast<int64_t>(size));
+                current.card->Account(size, current.phase, current.element);
+            }
+            return reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(raw) + header);
+        }
+
+        void Forget(Header const &block) {
+            total_.Live(-static_cast<int64_t>(block.size));
+            if (block.card) {
+                block.card->Live(-static_cast<int64_t>(block.size));
+            }
+        }
+
+    public:
+        static AllocTracker &instance() {
+            static AllocTracker tracker;
+            return tracker;
+        }
+
+        static Context &context() {
+            thread_local Context current;
+            return current;
+        }
+
+        // Counters for one showing of a card; they stay valid for the life of the process.
+        AllocCounters *NewCard() {
+            std::lock_guard<std::mutex> lock{cards_mutex_};
+            return &cards_.emplace_back();
+        }
+
+        void *Allocate(size_t size) {
+            auto const raw {std::malloc(size + header)};
+            return raw ? Place(raw, size) : nullptr;
+        }
+
+        void *Reallocate(void *ptr, size_t size) {
+            if (!ptr) {
+                return Allocate(size);
+            }
+            if (size == 0) {
+                Free(ptr);
+                return nullptr;
+            }
+            auto const old_block {header_of(ptr)};
+            auto const old {*old_block};
+            auto const raw {std::realloc(old_block, size + header)};
+            if (!raw) {
+                return nullptr;
+            }
+            Forget(old);
+            return Place(raw, size);
+        }
+
+        void Free(void *ptr) {
+            if (!ptr) {
+                return;
+            }
+            auto const block {header_of(ptr)};
+            Forget(*block);
+            std::free(block);
+        }
+
+        AllocReport Snapshot() const {
+            return total_.Snapshot();
+        }
+    };
+
+    class AllocScope {
+        decltype(AllocTracker::context()) current_;
+        Phase const phase_;
+        const char *const element_;
+    public:
+        AllocScope(Phase phase, const char *name)
+            : current_{AllocTracker::context()}, phase_{current_.phase}, element_{current_.element} {
+            current_.phase = phase;
+            if (phase == Phase::WidgetFactory) {
+                current_.element = name;
+            }
+        }
+        ~AllocScope() {
+            current_.phase = phase_;
+            current_.element = element_;
+        }
+        AllocScope(AllocScope const &) = delete;
+        AllocScope &operator=(AllocScope const &) = delete;
+    };
+
+    // Attributes this thread's allocations to `card` as well, for as long as it lives.
+    class AllocCardScope {
+        decltype(AllocTracker::context()) current_;
+        AllocCounters *const card_;
+    public:
+        explicit AllocCardScope(AllocCounters *card): current_{AllocTracker::context()}, card_{current_.card} {
+            current_.card = card;
+        }
+        ~AllocCardScope() {
+            current_.card = card_;
+        }
+        AllocCardScope(AllocCardScope const &) = delete;
+        AllocCardScope &operator=(AllocCardScope const &) = delete;
+    };
+
+    inline void WriteAllocReports(std::ostream &out, std::map<std::string, AllocReport> const &reports) {
+        rapidjson::OStreamWrapper stream{out};
+        rapidjson::Writer<rapidjson::OStreamWrapper> writer{stream};
+        auto const write_counter = [&writer](const char *name, AllocCounter const &counter) {
+            writer.Key(name);
+            writer.StartObject();
+            writer.Key("count");
+            writer.Uint64(counter.count);
+            writer.Key("bytes");
+            writer.Uint64(counter.bytes);
+            writer.EndObject();
+        };
+        writer.StartObject();
+        for (auto const &card: reports) {
+            writer.Key(card.first.c_str());
+            writer.StartObject();
+            writer.Key("live_bytes");
+            writer.Int64(card.second.live_bytes);
+            writer.Key("phases");
+            writer.StartObject();
+            for (size_t i = 0; i < card.second.phases.size(); ++i) {
+                write_counter(i < static_cast<size_t>(Phase::Count) ? phase_name(static_cast<Phase>(i)) : "other",
+                    card.second.phases[i]);
+            }
+            writer.EndObject();
+            writer.Key("elements");
+            writer.StartObject();
+            for (auto const &element: card.second.elements) {
+                write_counter(element.first, element.second);
+            }
+            writer.EndObject();
+            writer.EndObject();
+        }
+        writer.EndObject();
+        writer.Flush();
+    }
+
+    inline void *tracked_malloc(size_t size) { return AllocTracker::instance().Allocate(size); }
+    inline void *tracked_realloc(void *ptr, size_t size) { return AllocTracker::instance().Reallocate(ptr, size); }
+    inline void tracked_free(void *ptr) { AllocTracker::instance().Free(ptr); }
+}
+
+// Replacing the global operators is one definition per program: define
+// ADAPTIVECARDS_ALLOC_TRACKING_IMPL in exactly one translation unit.
+#ifdef ADAPTIVECARDS_ALLOC_TRACKING_IMPL
+void *operator new(std::size_t size) {
+    if (auto const ptr {AdaptiveCards::tracked_malloc(size)}) {
+        return ptr;
+    }
+    throw std::bad_alloc{};
+}
+void *operator new[](std::size_t size) {
+    return operator new(size);
+}
+void *operator new(std::size_t size, std::nothrow_t const &) noexcept {
+    return AdaptiveCards::tracked_malloc(size);
+}
+void *operator new[](std::size_t size, std::nothrow_t const &) noexcept {
+    return AdaptiveCards::tracked_malloc(size);
+}
+void operator delete(void *ptr) noexcept { AdaptiveCards::tracked_free(ptr); }
+void operator delete[](void *ptr) noexcept { AdaptiveCards::tracked_free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { AdaptiveCards::tracked_free(ptr); }
+void operator delete[](void *ptr, std::size_t) noexcept { AdaptiveCards::tracked_free(ptr); }
+void operator delete(void *ptr, std::nothrow_t const &) noexcept { AdaptiveCards::tracked_free(ptr); }
+void operator delete[](void *ptr, std::nothrow_t const &) noexcept { AdaptiveCards::tracked_free(ptr); }
+#endif
+
+#define AC_ALLOC_SCOPE(phase, name) \
+    ::AdaptiveCards::AllocScope AC_TRACE_JOIN(ac_alloc_scope_, __LINE__) {::AdaptiveCards::Phase::phase, name}
+#define AC_ALLOC_CARD(card) \
+    ::AdaptiveCards::AllocCardScope AC_TRACE_JOIN(ac_alloc_card_, __LINE__) {card}
+#else
+#define AC_ALLOC_SCOPE(phase, name)
+#define AC_ALLOC_CARD(card)
+#endif
@@ -0,0 +1,210 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace AdaptiveCards
+{
+    struct Choice {
+        std::string_view title;
+        std::string_view value;
+    };
+
+    // Case-folded titles laid out back to back, a title-sorted permutation for prefix
+    // lookups and a trigram -> choice posting list (CSR layout) for substring lookups.
+    // Choices are views; whoever owns the index keeps their storage alive.
+    class ChoiceIndex {
+        std::vector<Choice> choices_;
+        std::string folded_;
+        std::vector<uint32_t> offsets_;
+        std::vector<uint32_t> sorted_;
+        std::vector<uint32_t> trigram_keys_;
+        std::vector<uint32_t> trigram_offsets_;
+        std::vector<uint32_t> trigram_ids_;
+
+    public:
+        static char fold(char c) {
+            return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+        }
+
+        static std::string fold(std::string_view text) {
+            std::string result(text.size(), '\0');
+            std::transform(text.begin(), text.end(), result.begin(), [](char c) { return fold(c); });
+            return result;
+        }
+
+        static uint32_t trigram(char const *p) {
+            return static_cast<uint32_t>(static_cast<unsigned char>(p[0])) << 16
+                | static_cast<uint32_t>(static_cast<unsigned char>(p[1])) << 8
+                | static_cast<uint32_t>(static_cast<unsigned char>(p[2]));
+        }
+
+        explicit ChoiceIndex(std::vector<Choice> choices): choices_{std::move(choices)} {
+            size_t total {0};
+            for (auto const &choice: choices_) {
+                total += choice.title.size();
+            }
+            folded_.reserve(total);
+            offsets_.reserve(choices_.size() + 1);
+            offsets_.push_back(0);
+            for (auto const &choice: choices_) {
+                for (auto const c: choice.title) {
+                    folded_.push_back(fold(c));
+                }
+                offsets_.push_back(static_cast<uint32_t>(folded_.size()));
+            }
+
+            sorted_.resize(choices_.size());
+            std::iota(sorted_.begin(), sorted_.end(), 0u);
+            std::sort(sorted_.begin(), sorted_.end(), [this](uint32_t a, uint32_t b) {
+                return folded(a) < folded(b);
+            });
+
+            // (trigram, id) pairs come out in id order, so two stable 12-bit radix passes
+            // over the 24-bit trigram leave them sorted by trigram, then id.
+            std::vector<uint64_t> pairs;
+            pairs.reserve(total);
+            for (uint32_t id = 0; id < choices_.size(); ++id) {
+                auto const title {folded(id)};
+                for (size_t i = 0; i + 3 <= title.size(); ++i) {
+                    pairs.push_back(uint64_t{trigram(title.data() + i)} << 32 | id);
+                }
+            }
+            std::vector<uint64_t> scratch(pairs.size());
+            for (auto const shift: {32, 44}) {
+                std::vector<uint32_t> starts(4097, 0);
+                for (auto const pair: pairs) {
+                    ++starts[(pair >> shift & 0xfff) + 1];
+                }
+                std::partial_sum(starts.begin(), starts.end(), starts.begin());
+                for (auto const pair: pairs) {
+                    scratch[starts[pair >> shift & 0xfff]++] = pair;
+                }
+                pairs.swap(scratch);
+            }
+            pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+            trigram_ids_.reserve(pairs.size());
+            for (auto const pair: pairs) {
+                auto const key {static_cast<uint32_t>(pair >> 32)};
+                if (trigram_keys_.empty() || trigram_keys_.back() != key) {
+                    trigram_keys_.push_back(key);
+                    trigram_offsets_.push_back(static_cast<uint32_t>(trigram_ids_.size()));
+                }
+                trigram_ids_.push_back(static_cast<uint32_t>(pair));
+            }
+            trigram_offsets_.push_back(static_cast<uint32_t>(trigram_ids_.size()));
+        }
+
+        size_t size() const { return choices_.size(); }
+        Choice const &operator[](uint32_t id) const { return choices_[id]; }
+
+        std::string_view folded(uint32_t id) const {
+            return std::string_view{folded_}.substr(offsets_[id], offsets_[id + 1] - offsets_[id]);
+        }
+
+        // Ids whose folded title starts with `prefix`, in title order.
+        std::pair<uint32_t const *, uint32_t const *> WithPrefix(std::string_view prefix) const {
+            auto const first {std::lower_bound(sorted_.begin(), sorted_.end(), prefix, [this](uint32_t id, std::string_view p) {
+                return folded(id) < p;
+            })};
+            auto const last {std::upper_bound(first, sorted_.end(), prefix, [this](std::string_view p, uint32_t id) {
+                return folded(id).substr(0, p.size()) > p;
+            })};
+            return {sorted_.data() + (first - sorted_.begin()), sorted_.data() + (last - sorted_.begin())};
+        }
+
+        // Ids whose folded title contains `tri`, ascending.
+        std::pair<uint32_t const *, uint32_t const *> WithTrigram(uint32_t tri) const {
+            auto const pos {std::lower_bound(trigram_keys_.begin(), trigram_keys_.end(), tri)};
+            if (pos == trigram_keys_.end() || *pos != tri) {
+                return {nullptr, nullptr};
+            }
+            auto const slot {static_cast<size_t>(pos - trigram_keys_.begin())};
+            return {trigram_ids_.data() + trigram_offsets_[slot], trigram_ids_.data() + trigram_offsets_[slot + 1]};
+        }
+    };
+
+    // The filtering for one keystroke. Prefix matches come first (in title order), then the
+    // remaining substring matches (in choice order). Candidates are the previous query's
+    // results when the text only grew, else the rarest trigram's postings, else everything;
+    // Step() verifies them a slice at a time so a keystroke never blows the frame budget.
+    class ChoiceQuery {
+        ChoiceIndex const *index_;
+        std::string text_;
+        std::vector<uint32_t> candidates_;
+        bool all_candidates_{false};
+        size_t next_{0};
+        size_t prefix_count_{0};
+        std::vector<uint32_t> results_;
+
+        size_t candidate_count() const {
+            return all_candidates_ ? index_->size() : candidates_.size();
+        }
+
+    public:
+        ChoiceQuery(ChoiceIndex const &index, std::string_view text, ChoiceQuery const *previous = nullptr)
+            : index_{&index}, text_{ChoiceIndex::fold(text)} {
+            if (text_.empty()) {
+                results_.resize(index.size());
+                std::iota(results_.begin(), results_.end(), 0u);
+                return;
+            }
+            auto const prefix {index.WithPrefix(text_)};
+            results_.assign(prefix.first, prefix.second);
+            prefix_count_ = results_.size();
+            if (previous && previous->done() && previous->index_ == index_ && !previous->text_.empty()
+                    && text_.compare(0, previous->text_.size(), previous->text_) == 0) {
+                // A title the old text started can hold the new text further in, so both parts
+                // are candidates; the prefix part is in title order and is merged into id order.
+                auto const split {previous->results_.begin() + previous->prefix_count_};
+                std::vector<uint32_t> prefixed(previous->results_.begin(), split);
+                std::sort(prefixed.begin(), prefixed.end());
+                candidates_.resize(previous->results_.size());
+                std::merge(prefixed.begin(), prefixed.end(), split, previous->results_.end(), candidates_.begin());
+                return;
+            }
+            if (text_.size() < 3) {
+                all_candidates_ = true;
+                return;
+            }
+            std::pair<uint32_t const *, uint32_t const *> rarest {nullptr, nullptr};
+            for (size_t i = 0; i + 3 <= text_.size(); ++i) {
+                auto const postings {index.WithTrigram(ChoiceIndex::trigram(text_.data() + i))};
+                if (i == 0 || postings.second - postings.first < rarest.second - rarest.first) {
+                    rarest = postings;
+                }
+            }
+            candidates_.assign(rarest.first, rarest.second);
+        }
+
+        bool done() const { return next_ >= candidate_count(); }
+        std::string const &text() const { return text_; }
+        std::vector<uint32_t> const &results() const { return results_; }
+
+        // Verifies candidates until `budget` runs out; returns true once the query is complete.
+        bool Step(std::chrono::steady_clock::duration budget) {
+            auto const deadline {std::chrono::steady_clock::now() + budget};
+            auto const count {candidate_count()};
+            while (next_ < count) {
+                auto const slice_end {std::min(count, next_ + 512)};
+                for (; next_ < slice_end; ++next_) {
+                    auto const id {all_candidates_ ? static_cast<uint32_t>(next_) : candidates_[next_]};
+                    auto const title {index_->folded(id)};
+                    auto const pos {title.find(text_)};
+                    if (pos != std::string_view::npos && pos != 0) {
+                        results_.push_back(id);
+                    }
+                }
+                if (std::chrono::steady_clock::now() >= deadline) {
+                    break;
+                }
+            }
+            return done();
+        }
+    };
+}
@@ -0,0 +1,245 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <memory>
+#include <cstring>
+#include <functional>
+#include <vector>
+#include "adaptivecards-alloc.h"
+#include "rapidjson/rapidjson.h"
+#include "rapidjson/document.h"
+#include "adaptivecards-schema.h"
+
+namespace AdaptiveCards
+{
+    // rapidjson scans whitespace and strings 16 bytes at a time when built with RAPIDJSON_SSE42,
+    // RAPIDJSON_SSE2 or RAPIDJSON_NEON; the Makefile picks one from the target CPU's features.
+    inline char const *parser_simd() {
+#if defined(RAPIDJSON_SSE42)
+        return "sse4.2";
+#elif defined(RAPIDJSON_SSE2)
+        return "sse2";
+#elif defined(RAPIDJSON_NEON)
+        return "neon";
+#else
+        return "none";
+#endif
+    }
+
+    // False when the CPU running this lacks the instructions the parser was built for, as a
+    // binary built with ARCH=-march=native on one machine and run on an older one would.
+    inline bool parser_simd_supported() {
+#if defined(RAPIDJSON_SSE42) && defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+        return __builtin_cpu_supports("sse4.2");
+#else
+        return true;
+#endif
+    }
+
+    // Owns the single copy of a JSON source; the DOM is parsed in place over it, so
+    // every string in the document is a view into this buffer.
+    class Arena {
+        std::string source_;
+        rapidjson::Document doc_;
+        size_t bytes_{0};
+        std::string error_;
+    public:
+        explicit Arena(std::string &&src): source_{std::move(src)} {
+            doc_.ParseInsitu(source_.data());
+            bytes_ = source_.capacity() + doc_.GetAllocator().Capacity();
+        }
+        // A card template, checked against the card schema; see TemplateParser.
+        Arena(std::string &&src, TemplateParser &parser): source_{std::move(src)} {
+            error_ = parser.Parse(source_, doc_);
+            bytes_ = source_.capacity() + doc_.GetAllocator().Capacity();
+        }
+        explicit Arena(std::string_view src): Arena{std::string{src}} {}
+        Arena(Arena const &) = delete;
+        Arena &operator=(Arena const &) = delete;
+
+        rapidjson::Document &doc() { return doc_; }
+        rapidjson::Document const &doc() const { return doc_; }
+        size_t size() const { return source_.size(); }
+        // Source plus DOM pool, the memory the arena holds on to.
+        size_t bytes() const { return bytes_; }
+        // Why a template was rejected; its document is then an empty object.
+        std::string const &error() const { return error_; }
+    };
+
+    // A card keeps its template and data arenas alive for as long as any widget built from it.
+    // Rows of a repeated element may hold on to an older data arena until they are rebound.
+    class Card {
+        std::unique_ptr<Arena> template_;
+        std::shared_ptr<Arena> data_;
+    public:
+        explicit Card(std::string &&card_template):
+            template_{std::make_unique<Arena>(std::move(card_template), TemplateParser::instance())} {}
+
+        rapidjson::Document &doc() { return template_->doc(); }
+        rapidjson::Document const &data() const { return data_->doc(); }
+        std::shared_ptr<Arena const> data_arena() const { return data_; }
+        void SetData(std::string &&data) { data_ = std::make_shared<Arena>(std::move(data)); }
+        // Back to the compiled template only; widgets still bound to the data keep it alive.
+        void ReleaseData() { data_.reset(); }
+        bool has_data() const { return data_ != nullptr; }
+        std::string const &error() const { return template_->error(); }
+        size_t bytes() const { return template_->bytes() + (data_ ? data_->bytes() : 0); }
+    };
+
+    inline std::string_view view(rapidjson::Value const &value) {
+        return value.IsString() ? std::string_view{value.GetString(), value.GetStringLength()} : std::string_view{};
+    }
+
+    inline std::string_view member_view(rapidjson::Value const &element, const char *name, std::string_view fallback = {}) {
+        if (!element.IsObject()) {
+            return fallback;
+        }
+        auto const pos {element.FindMember(name)};
+        return pos != element.MemberEnd() && pos->value.IsString() ? view(pos->value) : fallback;
+    }
+
+    // "${path}" -> "path"; anything else is a literal and yields an empty view.
+    inline std::string_view binding_path(std::string_view text) {
+        if (text.size() > 3 && text.substr(0, 2) == "${" && text.back() == '}') {
+            return text.substr(2, text.size() - 3);
+        }
+        return {};
+    }
+
+    // An empty path resolves to `root` itself.
+    inline rapidjson::Value const *resolve(rapidjson::Value const &root, std::string_view path, char delimiter = '.') {
+        auto current {&root};
+        if (path.empty()) {
+            return current;
+        }
+        while (current) {
+            auto const end {path.find(delimiter)};
+            auto const member {path.substr(0, end)};
+            if (!current->IsObject()) {
+                return nullptr;
+            }
+            auto const pos {current->FindMember(rapidjson::Value{rapidjson::StringRef(member.data(), member.size())})};
+            current = pos != current->MemberEnd() ? &pos->value : nullptr;
+            if (end == std::string_view::npos) {
+                break;
+            }
+            path.remove_prefix(end + 1);
+        }
+        return current;
+    }
+
+    inline void append_value(std::string &out, rapidjson::Value const &value) {
+        if (value.IsString()) {
+            out.append(value.GetString(), value.GetStringLength());
+        }
+        else if (value.IsBool()) {
+            out.append(value.GetBool() ? "true" : "false");
+        }
+        else if (value.IsInt64()) {
+            out.append(std::to_string(value.GetInt64()));
+        }
+        else if (value.IsUint64()) {
+            out.append(std::to_string(value.GetUint64()));
+        }
+        else if (value.IsNumber()) {
+            out.append(std::to_string(value.GetDouble()));
+        }
+    }
+
+    // Replaces every "${path}" inside `text` with its value in `scope`; unresolved paths are dropped.
+    inline std::string interpolate(std::string_view text, rapidjson::Value const *scope) {
+        std::string result;
+        result.reserve(text.size());
+        while (!text.empty()) {
+            auto const start {text.find("${")};
+            auto const end {start == std::string_view::npos ? start : text.find('}', start)};
+            if (end == std::string_view::npos) {
+                result.append(text);
+                break;
+            }
+            result.append(text.substr(0, start));
+            if (scope) {
+                if (auto const value {resolve(*scope, text.substr(start + 2, end - start - 2))}) {
+                    append_value(result, *value);
+                }
+            }
+            text.remove_prefix(end + 1);
+        }
+        return result;
+    }
+
+    inline size_t hash_value(rapidjson::Value const &value, size_t hash = 14695981039346656037ull) {
+        auto const mix = [&hash](void const *data, size_t size) {
+            for (auto byte {static_cast<unsigned char const *>(data)}; size--; ++byte) {
+                hash = (hash ^ *byte) * 1099511628211ull;
+            }
+        };
+        auto const type {static_cast<unsigned char>(value.GetType())};
+        mix(&type, 1);
+        if (value.IsString()) {
+            mix(value.GetString(), value.GetStringLength());
+        }
+        else if (value.IsNumber()) {
+            auto const number {value.GetDouble()};
+            mix(&number, sizeof(number));
+        }
+        else if (value.IsObject()) {
+            for (auto const &member: value.GetObject()) {
+                hash = hash_value(member.name, hash);
+                hash = hash_value(member.value, hash);
+            }
+        }
+        else if (value.IsArray()) {
+            for (auto const &item: value.GetArray()) {
+                hash = hash_value(item, hash);
+            }
+        }
+        return hash;
+    }
+
+    using TSetter = std::function<void(std::string_view)>;
+    using TArraySetter = std::function<void(rapidjson::Value const *items, std::shared_ptr<Arena const> const &arena)>;
+    using TValueSetter = std::function<void(rapidjson::Value const *value, std::shared_ptr<Arena const> const &arena)>;
+    using TSinks = std::vector<std::pair<std::string_view,TValueSetter>>;
+
+    // Handed to element factories: literal values are applied immediately, "${path}"
+    // bindings are collected into the sinks and applied by ResolveSinks.
+    class ExpressionSet {
+        TSinks *sinks_;
+    public:
+        explicit ExpressionSet(TSinks &sinks): sinks_{&sinks} {}
+
+        void operator()(TSetter setter, std::string_view value) const {
+            auto const path {binding_path(value)};
+            if (path.empty()) {
+                setter(value);
+                return;
+            }
+            sinks_->emplace_back(path, [setter](rapidjson::Value const *bound, std::shared_ptr<Arena const> const &) {
+                setter(bound ? view(*bound) : std::string_view{});
+            });
+        }
+
+        // Receives the whole data scope, for elements that interpolate several fields.
+        void Scope(TValueSetter setter) const {
+            sinks_->emplace_back(std::string_view{}, std::move(setter));
+        }
+
+        void Array(TArraySetter setter, std::string_view value) const {
+            auto const path {binding_path(value)};
+            if (path.empty()) {
+                return;
+            }
+            sinks_->emplace_back(path, [setter](rapidjson::Value const *bound, std::shared_ptr<Arena const> const &arena) {
+                setter(bound && bound->IsArray() ? bound : nullptr, arena);
+            });
+        }
+    };
+
+    inline void ResolveSinks(TSinks &sinks, rapidjson::Value const &data, std::shared_ptr<Arena const> const &arena) {
+        AC_TRACE_SCOPE(ResolveSinks, "ResolveSinks");
+        for (auto &sink: sinks) {
+            sink.second(resolve(data, sink.first), arena);
+        }
+    }
+}
@@ -0,0 +1,331 @@
+#pragma once
+#include <algorithm>
+#include <csetjmp>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+#include <jpeglib.h>
+#include <png.h>
+#include "adaptivecards-gif.h"
+#include "adaptivecards-resample.h"
+
+namespace AdaptiveCards
+{
+    enum class ImageFormat {
+        Unknown,
+        Jpeg,
+        Png,
+        Gif
+    };
+
+    inline ImageFormat SniffFormat(std::string_view bytes) {
+        if (bytes.size() >= 3 && bytes.substr(0, 3) == "\xFF\xD8\xFF") {
+            return ImageFormat::Jpeg;
+        }
+        if (bytes.size() >= 8 && bytes.substr(0, 8) == "\x89PNG\r\n\x1A\n") {
+            return ImageFormat::Png;
+        }
+        if (bytes.size() >= 6 && (bytes.substr(0, 6) == "GIF87a" || bytes.substr(0, 6) == "GIF89a")) {
+            return ImageFormat::Gif;
+        }
+        return ImageFormat::Unknown;
+    }
+
+    struct DecodeStats {
+        int source_width{0};
+        int source_height{0};
+        int decoded_width{0};
+        int decoded_height{0};
+        // Largest set of pixel buffers held at once; the codecs' own state is not counted.
+        size_t peak_bytes{0};
+    };
+
+    // Shrinks by an integer factor as rows arrive, averaging each factor x factor block in
+    // premultiplied alpha. Only one output row of sums is held.
+    class BoxReducer {
+        RgbaImage image_;
+        std::vector<uint64_t> sums_;
+        int source_width_;
+        int factor_;
+        int rows_{0};
+        int y_{0};
+
+        void Emit() {
+            auto out {image_.row(y_)};
+            for (int x = 0; x < image_.width; ++x, out += 4) {
+                auto const sum {sums_.data() + size_t(x) * 4};
+                auto const alpha {sum[3]};
+                auto const columns {std::min(factor_, source_width_ - x * factor_)};
+                auto const count {uint64_t(columns) * rows_};
+                for (int c = 0; c < 3; ++c) {
+                    out[c] = alpha ? uint8_t((sum[c] + alpha / 2) / alpha) : 0;
+                }
+                out[3] = uint8_t((alpha + count / 2) / count);
+            }
+            std::fill(sums_.begin(), sums_.end(), 0);
+            rows_ = 0;
+            ++y_;
+        }
+
+    public:
+        BoxReducer(int source_width, int source_height, int factor)
+            : image_{(source_width + factor - 1) / factor, (source_height + factor - 1) / factor},
+              sums_(size_t(image_.width) * 4), source_width_{source_width}, factor_{factor} {}
+
+        void AddRow(uint8_t const *rgba) {
+            auto sum {sums_.data()};
+            for (int x = 0; x < source_width_; x += factor_, sum += 4) {
+                uint32_t r {0}, g {0}, b {0}, a {0};
+                for (auto const end {rgba + size_t(std::min(factor_, source_width_ - x)) * 4}; rgba != end; rgba += 4) {
+                    uint32_t const alpha {rgba[3]};
+                    r += rgba[0] * alpha;
+                    g += rgba[1] * alpha;
+                    b += rgba[2] * alpha;
+                    a += alpha;
+                }
+                sum[0] += r;
+                sum[1] += g;
+                sum[2] += b;
+                sum[3] += a;
+            }
+            if (++rows_ == factor_) {
+                Emit();
+            }
+        }
+
+        RgbaImage Finish() {
+            if (rows_ > 0) {
+                Emit();
+            }
+            return std::move(image_);
+        }
+
+        size_t bytes() const { return image_.bytes() + sums_.size() * sizeof(uint64_t); }
+    };
+
+    namespace detail {
+        struct JpegError {
+            jpeg_error_mgr manager;
+            std::jmp_buf jump;
+        };
+
+        [[noreturn]] inline void jpeg_fail(j_common_ptr info) {
+            std::longjmp(reinterpret_cast<JpegError *>(info->err)->jump, 1);
+        }
+
+        inline void jpeg_quiet(j_common_ptr) {}
+
+        // Everything DecodeJpeg() touches after its setjmp lives here, on the heap behind a
+        // pointer set before it, so a libjpeg error never leaves an automatic indeterminate.
+        struct JpegDecode {
+            jpeg_decompress_struct info;
+            JpegError error;
+            RgbaImage image;
+            std::vector<JSAMPLE> rgb;
+        };
+
+        // Everything DecodePng() touches after its setjmp lives here, on the heap behind a
+        // pointer set before it, so a libpng error never leaves an automatic indeterminate.
+        struct PngDecode {
+            std::string_view bytes;
+            size_t offset{0};
+            std::vector<uint8_t> rows;
+            std::vector<png_bytep> pointers;
+            std::unique_ptr<BoxReducer> reducer;
+        };
+
+        inline void png_read(png_structp png, png_bytep out, png_size_t length) {
+            auto const source {static_cast<PngDecode *>(png_get_io_ptr(png))};
+            if (source->bytes.size() - source->offset < length) {
+                png_error(png, "truncated");
+            }
+            std::memcpy(out, source->bytes.data() + source->offset, length);
+            source->offset += length;
+        }
+
+        [[noreturn]] inline void png_fail(png_structp png, png_const_charp) {
+            png_longjmp(png, 1);
+        }
+
+        inline void png_quiet(png_structp, png_const_charp) {}
+    }
+
+    // Decodes with the IDCT scaled by 1/2, 1/4 or 1/8 when the result stays at least
+    // `target_width` wide (0 decodes at full size). Empty when the data is not a JPEG.
+    inline RgbaImage DecodeJpeg(std::string_view bytes, int target_width, DecodeStats *stats = nullptr) {
+        auto const state {std::make_unique<detail::JpegDecode>()};
+        auto &info {state->info};
+        info.err = jpeg_std_error(&state->error.manager);
+        state->error.manager.error_exit = &detail::jpeg_fail;
+        state->error.manager.output_message = &detail::jpeg_quiet;
+        if (setjmp(state->error.jump)) {
+            jpeg_destroy_decompress(&info);
+            return {};
+        }
+        jpeg_create_decompress(&info);
+        jpeg_mem_src(&info, reinterpret_cast<unsigned char const *>(bytes.data()), bytes.size());
+        jpeg_read_header(&info, TRUE);
+        info.scale_num = 1;
+        info.scale_denom = 1;
+        for (unsigned const denom: {8u, 4u, 2u}) {
+            if (target_width > 0 && info.image_width / denom >= unsigned(target_width)) {
+                info.scale_denom = denom;
+                break;
+            }
+        }
+#ifdef JCS_EXTENSIONS
+        info.out_color_space = JCS_EXT_RGBA;
+#else
+        info.out_color_space = JCS_RGB;
+#endif
+        jpeg_start_decompress(&info);
+        auto &image {state->image};
+        auto &rgb {state->rgb};
+        image = RgbaImage{int(info.output_width), int(info.output_height)};
+        if (info.output_components == 3) {
+            rgb.resize(size_t(info.output_width) * 3);
+        }
+        while (info.output_scanline < info.output_height) {
+            auto const out {image.row(int(info.output_scanline))};
+            JSAMPROW row {rgb.empty() ? out : rgb.data()};
+            jpeg_read_scanlines(&info, &row, 1);
+            if (!rgb.empty()) {
+                for (size_t x = 0; x < info.output_width; ++x) {
+                    std::memcpy(out + x * 4, rgb.data() + x * 3, 3);
+                    out[x * 4 + 3] = 0xFF;
+                }
+            }
+        }
+        if (stats) {
+            stats->source_width = int(info.image_width);
+            stats->source_height = int(info.image_height);
+            stats->decoded_width = image.width;
+            stats->decoded_height = image.height;
+            stats->peak_bytes = image.bytes() + rgb.size();
+        }
+        jpeg_finish_decompress(&info);
+        jpeg_destroy_decompress(&info);
+        return std::move(image);
+    }
+
+    // Decodes row by row, averaging blocks of the largest integer factor that keeps the
+    // result at least `target_width` wide, so the full-size image is never held. Interlaced
+    // files need all passes first and are reduced afterwards.
+    inline RgbaImage DecodePng(std::string_view bytes, int target_width, DecodeStats *stats = nullptr) {
+        auto const state {std::make_unique<detail::PngDecode>()};
+        state->bytes = bytes;
+        auto png {png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, &detail::png_fail, &detail::png_quiet)};
+        if (!png) {
+            return {};
+        }
+        auto info {png_create_info_struct(png)};
+        if (!info) {
+            png_destroy_read_struct(&png, nullptr, nullptr);
+            return {};
+        }
+        if (setjmp(png_jmpbuf(png))) {
+            png_destroy_read_struct(&png, &info, nullptr);
+            return {};
+        }
+        png_set_read_fn(png, state.get(), &detail::png_read);
+        png_read_info(png, info);
+        auto const width {int(png_get_image_width(png, info))};
+        auto const height {int(png_get_image_height(png, info))};
+        auto const color_type {png_get_color_type(png, info)};
+        png_set_expand(png);
+        png_set_strip_16(png);
+        if (color_type == PNG_COLOR_TYPE_GRAY || color_type == PNG_COLOR_TYPE_GRAY_ALPHA) {
+            png_set_gray_to_rgb(png);
+        }
+        if (!(color_type & PNG_COLOR_MASK_ALPHA) && !png_get_valid(png, info, PNG_INFO_tRNS)) {
+            png_set_filler(png, 0xFF, PNG_FILLER_AFTER);
+        }
+        auto const passes {png_set_interlace_handling(png)};
+        png_read_update_info(png, info);
+
+        auto const factor {target_width > 0 ? std::max(1, width / target_width) : 1};
+        state->reducer = std::make_unique<BoxReducer>(width, height, factor);
+        size_t const stride {size_t(width) * 4};
+        if (passes > 1) {
+            state->rows.resize(stride * height);
+            state->pointers.resize(height);
+            for (int y = 0; y < height; ++y) {
+                state->pointers[y] = state->rows.data() + y * stride;
+            }
+            png_read_image(png, state->pointers.data());
+            for (int y = 0; y < height; ++y) {
+                state->reducer->AddRow(state->pointers[y]);
+            }
+        }
+        else {
+            state->rows.resize(stride);
+            for (int y = 0; y < height; ++y) {
+                png_read_row(png, state->rows.data(), nullptr);
+                state->reducer->AddRow(state->rows.data());
+            }
+        }
+        png_read_end(png, nullptr);
+        png_destroy_read_struct(&png, &info, nullptr);
+        auto const peak {state->reducer->bytes() + state->rows.size()};
+        auto image {state->reducer->Finish()};
+        if (stats) {
+            stats->source_width = width;
+            stats->source_height = height;
+            stats->decoded_width = image.width;
+            stats->decoded_height = image.height;
+            stats->peak_bytes = peak;
+        }
+        return image;
+    }
+
+    // The first frame; animated GIFs are played by the widgets through GifDecoder. Frames
+    // are no larger than the logical screen, so there is nothing to gain by scaling early.
+    inline RgbaImage DecodeGif(std::string_view bytes, DecodeStats *stats = nullptr) {
+        GifDecoder gif {bytes};
+        auto const frame {gif.Frame(0)};
+        if (!frame) {
+            return {};
+        }
+        if (stats) {
+            stats->source_width = stats->decoded_width = frame->width;
+            stats->source_height = stats->decoded_height = frame->height;
+            stats->peak_bytes = frame->bytes() + size_t(frame->width) * frame->height;
+        }
+        return *frame;
+    }
+
+    // Decodes near `target_width` and resamples to exactly that width, keeping the aspect
+    // ratio. Empty for formats other than JPEG, PNG and GIF, which callers decode themselves.
+    inline RgbaImage DecodeScaled(std::string_view bytes, int target_width, DecodeStats *stats = nullptr) {
+        DecodeStats decode;
+        RgbaImage decoded;
+        switch (SniffFormat(bytes)) {
+            case ImageFormat::Jpeg:
+                decoded = DecodeJpeg(bytes, target_width, &decode);
+                break;
+            case ImageFormat::Png:
+                decoded = DecodePng(bytes, target_width, &decode);
+                break;
+            case ImageFormat::Gif:
+                decoded = DecodeGif(bytes, &decode);
+                break;
+            case ImageFormat::Unknown:
+                break;
+        }
+        auto const target_height {decoded.empty() || target_width <= 0 ? 0
+            : std::max(1, int(int64_t(decode.source_height) * target_width / decode.source_width))};
+        if (target_height && (decoded.width != target_width || decoded.height != target_height)) {
+            auto const scratch {ResampleScratchBytes(decoded, target_width)};
+            auto resampled {Resample(decoded, target_width, target_height)};
+            decode.peak_bytes = std::max(decode.peak_bytes, decoded.bytes() + scratch + resampled.bytes());
+            decoded = std::move(resampled);
+        }
+        if (stats) {
+            *stats = decode;
+        }
+        return decoded;
+    }
+}
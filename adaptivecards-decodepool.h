@@ -0,0 +1,281 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "adaptivecards-decode.h"
+#include "adaptivecards-fetch.h"
+#include "adaptivecards-mask.h"
+
+namespace AdaptiveCards
+{
+    struct DecodePoolStats {
+        uint64_t requested{0};
+        uint64_t decoded{0};
+        // Made from an already decoded, larger image of the same URL instead of its bytes.
+        uint64_t resized{0};
+        uint64_t joined{0};
+        uint64_t failed{0};
+        uint64_t cancelled{0};
+        uint64_t decode_us{0};
+    };
+
+    // Decodes and resamples fetched images on worker threads, lowest priority value first,
+    // so the UI thread only turns finished pixels into a bitmap. Requests for the same URL
+    // and width share one decode. An image already decoded at a larger size is shrunk
+    // rather than decoded again. Circular (Person style) requests are masked on the worker
+    // too. Like FetchPool, requests belong to an owner that collects
+    // results with Take() when notified and may cancel them all at once.
+    class DecodePool {
+    public:
+        using TTicket = uint64_t;
+        using TBytes = FetchPool::TBytes;
+        using TImage = std::shared_ptr<RgbaImage const>;
+        using TNotify = std::function<void()>;
+
+        struct Result {
+            TTicket ticket;
+            // Null when the bytes are not JPEG or PNG, or are broken.
+            TImage image;
+        };
+
+    private:
+        struct Key {
+            std::string url;
+            int width;
+            bool circular;
+
+            bool operator<(Key const &other) const {
+                return std::tie(width, circular, url) < std::tie(other.width, other.circular, other.url);
+            }
+        };
+
+        struct Pending {
+            void const *owner;
+            Key key;
+            bool done{false};
+            TImage image;
+        };
+
+        struct Job {
+            TBytes bytes;
+            TImage source;
+            int priority;
+            bool running{false};
+            std::vector<TTicket> waiters;
+        };
+
+        using TJobs = std::map<Key, Job>;
+
+        std::mutex mutex_;
+        std::condition_variable wake_;
+        std::map<TTicket, Pending> requests_;
+        TJobs jobs_;
+        TTicket next_ticket_{1};
+        DecodePoolStats stats_;
+        TNotify notify_;
+        bool stopping_{false};
+        std::vector<std::thread> workers_;
+
+        TJobs::iterator Next() {
+            auto next {jobs_.end()};
+            for (auto pos {jobs_.begin()}; pos != jobs_.end(); ++pos) {
+                if (pos->second.running) {
+                    continue;
+                }
+                if (next == jobs_.end() || std::make_pair(pos->second.priority, pos->second.waiters.front())
+                        < std::make_pair(next->second.priority, next->second.waiters.front())) {
+                    next = pos;
+                }
+            }
+            return next;
+        }
+
+        void Remove(TTicket ticket) {
+            auto const pos {requests_.find(ticket)};
+            if (pos == requests_.end()) {
+                return;
+            }
+            auto const job {jobs_.find(pos->second.key)};
+            auto const done {pos->second.done};
+            requests_.erase(pos);
+            if (done || job == jobs_.end()) {
+                return;
+            }
+            ++stats_.cancelled;
+            auto &waiters {job->second.waiters};
+            waiters.erase(std::remove(waiters.begin(), waiters.end(), ticket), waiters.end());
+            if (waiters.empty() && !job->second.running) {
+                jobs_.erase(job);
+            }
+        }
+
+        void Run() {
+            std::unique_lock<std::mutex> lock{mutex_};
+            for (;;) {
+                wake_.wait(lock, [this] { return stopping_ || Next() != jobs_.end(); });
+                if (stopping_) {
+                    return;
+                }
+                auto const pos {Next()};
+                auto const key {pos->first};
+                auto const bytes {std::move(pos->second.bytes)};
+                auto const source {std::move(pos->second.source)};
+                pos->second.running = true;
+                lock.unlock();
+
+                TImage image;
+                auto const start {std::chrono::steady_clock::now()};
+                try {
+                    auto decoded {source
+                        ? Resample(*source, key.width, std::max(1, int(int64_t(source->height) * key.width / source->width)))
+                        : DecodeScaled(*bytes, key.width)};
+                    // A shrunk source had its mask applied already.
+                    if (key.circular && !source && !decoded.empty()) {
+                        ApplyCircle(decoded);
+                    }
+                    if (!decoded.empty()) {
+                        image = std::make_shared<RgbaImage const>(std::move(decoded));
+                    }
+                }
+                catch (...) {
+                }
+                auto const elapsed {std::chrono::steady_clock::now() - start};
+
+                lock.lock();
+                stats_.decode_us += uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+                ++(!image ? stats_.failed : source ? stats_.resized : stats_.decoded);
+                auto const done {jobs_.find(key)};
+                auto const delivered {!done->second.waiters.empty()};
+                for (auto const ticket: done->second.waiters) {
+                    auto &request {requests_.at(ticket)};
+                    request.done = true;
+                    request.image = image;
+                }
+                jobs_.erase(done);
+                if (auto const notify {notify_}; notify && delivered) {
+                    lock.unlock();
+                    notify();
+                    lock.lock();
+                }
+            }
+        }
+
+        TTicket Add(void const *owner, std::string_view url, Job &&added, int width, bool circular) {
+            TTicket ticket;
+            {
+                std::lock_guard<std::mutex> lock{mutex_};
+                ticket = next_ticket_++;
+                Key key {std::string{url}, width, circular};
+                auto job {jobs_.find(key)};
+                if (job == jobs_.end()) {
+                    job = jobs_.emplace(key, std::move(added)).first;
+                }
+                else {
+                    ++stats_.joined;
+                    job->second.priority = std::min(job->second.priority, added.priority);
+                }
+                job->second.waiters.push_back(ticket);
+                requests_.emplace(ticket, Pending{owner, std::move(key)});
+                ++stats_.requested;
+            }
+            wake_.notify_one();
+            return ticket;
+        }
+
+    public:
+        explicit DecodePool(size_t workers, TNotify notify = {}): notify_{std::move(notify)} {
+            for (size_t i = 0; i < workers; ++i) {
+                workers_.emplace_back([this] { Run(); });
+            }
+        }
+        DecodePool(DecodePool const &) = delete;
+        DecodePool &operator=(DecodePool const &) = delete;
+
+        ~DecodePool() {
+            Shutdown();
+        }
+
+        // Half the cores, leaving the rest to the UI thread and the fetch workers.
+        static DecodePool &instance() {
+            static DecodePool pool {std::clamp<size_t>(std::thread::hardware_concurrency() / 2, 1, 4)};
+            return pool;
+        }
+
+        void SetNotify(TNotify notify) {
+            std::lock_guard<std::mutex> lock{mutex_};
+            notify_ = std::move(notify);
+        }
+
+        // Decodes `bytes` of `url` to `width` pixels across.
+        TTicket Request(void const *owner, std::string_view url, TBytes bytes, int width, int priority, bool circular = false) {
+            return Add(owner, url, Job{std::move(bytes), nullptr, priority}, width, circular);
+        }
+
+        // Shrinks `source`, a larger decode of `url` with the same `circular`, to `width` pixels across.
+        TTicket Shrink(void const *owner, std::string_view url, TImage source, int width, int priority, bool circular = false) {
+            return Add(owner, url, Job{nullptr, std::move(source), priority}, width, circular);
+        }
+
+        void Cancel(TTicket ticket) {
+            std::lock_guard<std::mutex> lock{mutex_};
+            Remove(ticket);
+        }
+
+        void CancelOwner(void const *owner) {
+            std::lock_guard<std::mutex> lock{mutex_};
+            std::vector<TTicket> tickets;
+            for (auto const &request: requests_) {
+                if (request.second.owner == owner) {
+                    tickets.push_back(request.first);
+                }
+            }
+            for (auto const ticket: tickets) {
+                Remove(ticket);
+            }
+        }
+
+        std::vector<Result> Take(void const *owner) {
+            std::vector<Result> results;
+            std::lock_guard<std::mutex> lock{mutex_};
+            for (auto pos {requests_.begin()}; pos != requests_.end();) {
+                if (pos->second.owner == owner && pos->second.done) {
+                    results.push_back({pos->first, std::move(pos->second.image)});
+                    pos = requests_.erase(pos);
+                }
+                else {
+                    ++pos;
+                }
+            }
+            return results;
+        }
+
+        void Shutdown() {
+            {
+                std::lock_guard<std::mutex> lock{mutex_};
+                stopping_ = true;
+            }
+            wake_.notify_all();
+            for (auto &worker: workers_) {
+                if (worker.joinable()) {
+                    worker.join();
+                }
+            }
+        }
+
+        DecodePoolStats stats() {
+            std::lock_guard<std::mutex> lock{mutex_};
+            return stats_;
+        }
+    };
+}
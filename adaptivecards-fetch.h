@@ -0,0 +1,567 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "adaptivecards-alloc.h"
+#include "rapidjson/ostreamwrapper.h"
+#include "rapidjson/writer.h"
+
+namespace AdaptiveCards
+{
+    // Read-only bytes shared between the caches, fetch and decode workers; whatever holds
+    // the memory (a string, a mapped file) lives as long as the view.
+    using TBytes = std::shared_ptr<std::string_view const>;
+
+    inline TBytes SharedBytes(std::string &&bytes) {
+        struct Owned {
+            std::string bytes;
+            std::string_view view;
+        };
+        auto owned {std::make_shared<Owned>()};
+        owned->bytes = std::move(bytes);
+        owned->view = owned->bytes;
+        return {owned, &owned->view};
+    }
+
+    // Fetched bytes (images for now) by URL, least recently used evicted past the budget.
+    class ResourceCache {
+    public:
+        using TBytes = AdaptiveCards::TBytes;
+
+    private:
+        using TOrder = std::list<std::string>;
+
+        mutable std::mutex mutex_;
+        TOrder order_;
+        std::unordered_map<std::string_view, std::pair<TBytes, TOrder::iterator>> entries_;
+        size_t bytes_{0};
+        size_t budget_;
+
+    public:
+        explicit ResourceCache(size_t budget): budget_{budget} {}
+
+        static ResourceCache &instance() {
+            static ResourceCache cache {16 << 20};
+            return cache;
+        }
+
+        TBytes Find(std::string_view url) {
+            std::lock_guard<std::mutex> lock{mutex_};
+            auto const pos {entries_.find(url)};
+            if (pos == entries_.end()) {
+                return nullptr;
+            }
+            order_.splice(order_.begin(), order_, pos->second.second);
+            return pos->second.first;
+        }
+
+        bool Contains(std::string_view url) const {
+            std::lock_guard<std::mutex> lock{mutex_};
+            return entries_.count(url) != 0;
+        }
+
+        // The cached bytes for `url`: these, or what was already there. Larger than the
+        // whole budget is returned without being kept.
+        TBytes Insert(std::string_view url, std::string &&bytes) {
+            std::lock_guard<std::mutex> lock{mutex_};
+            if (auto const pos {entries_.find(url)}; pos != entries_.end()) {
+                return pos->second.first;
+            }
+            auto shared {SharedBytes(std::move(bytes))};
+            if (shared->size() > budget_) {
+                return shared;
+            }
+            bytes_ += shared->size();
+            order_.emplace_front(url);
+            entries_.emplace(order_.front(), std::make_pair(shared, order_.begin()));
+            while (bytes_ > budget_) {
+                auto const pos {entries_.find(order_.back())};
+                bytes_ -= pos->second.first->size();
+                entries_.erase(pos);
+                order_.pop_back();
+            }
+            return shared;
+        }
+
+        size_t bytes() const {
+            std::lock_guard<std::mutex> lock{mutex_};
+            return bytes_;
+        }
+    };
+
+    // What image transfers may cost, shared by every card; read when a transfer starts.
+    struct FetchLimits {
+        std::chrono::milliseconds connect_timeout{5000};
+        std::chrono::milliseconds timeout{30000};
+        // A transfer receiving less than stall_bytes a second for stall_time is dropped.
+        long stall_bytes{1024};
+        std::chrono::seconds stall_time{10};
+        // Larger bodies are dropped, whether announced or found out while receiving.
+        size_t max_body_bytes{8 << 20};
+        // What all transfers together may receive a second; 0 for no limit.
+        size_t bytes_per_second{0};
+        // Transfers at once: the workers of FetchPool::instance(), set before its first use.
+        size_t concurrency{4};
+    };
+
+    inline FetchLimits &fetch_limits() {
+        static FetchLimits limits;
+        return limits;
+    }
+
+    // Token bucket over the bytes every transfer receives, refilled at
+    // fetch_limits().bytes_per_second with at most a second's worth banked. A receiver may
+    // overdraw it; Take() then says how long to wait before reading more.
+    class Bandwidth {
+        using TClock = std::chrono::steady_clock;
+
+        std::mutex mutex_;
+        double available_{0};
+        TClock::time_point refilled_{TClock::now()};
+
+    public:
+        static Bandwidth &instance() {
+            static Bandwidth bandwidth;
+            return bandwidth;
+        }
+
+        std::chrono::microseconds Take(size_t bytes, size_t bytes_per_second = fetch_limits().bytes_per_second) {
+            if (bytes_per_second == 0) {
+                return {};
+            }
+            std::lock_guard<std::mutex> lock{mutex_};
+            auto const now {TClock::now()};
+            auto const rate {double(bytes_per_second)};
+            available_ = std::min(rate, available_ + std::chrono::duration<double>(now - refilled_).count() * rate);
+            refilled_ = now;
+            available_ -= double(bytes);
+            if (available_ >= 0) {
+                return {};
+            }
+            return std::chrono::microseconds{int64_t(-available_ / rate * 1e6)};
+        }
+    };
+
+    enum class TransferOutcome { Completed, Failed, TimedOut, TooLarge, Cancelled };
+
+    struct TransferStats {
+        uint64_t completed{0};
+        // Connection and HTTP errors.
+        uint64_t failed{0};
+        uint64_t timed_out{0};
+        uint64_t too_large{0};
+        uint64_t cancelled{0};
+        uint64_t bytes{0};
+        uint64_t connect_us{0};
+        uint64_t total_us{0};
+        uint64_t max_total_us{0};
+        // Spent waiting on the bandwidth budget.
+        uint64_t throttled_us{0};
+    };
+
+    // Totals over every network transfer, whichever pool or thread made it.
+    class TransferMetrics {
+        mutable std::mutex mutex_;
+        TransferStats stats_;
+
+    public:
+        static TransferMetrics &instance() {
+            static TransferMetrics metrics;
+            return metrics;
+        }
+
+        void Record(TransferOutcome outcome, uint64_t bytes, uint64_t connect_us, uint64_t total_us, uint64_t throttled_us) {
+            std::lock_guard<std::mutex> lock{mutex_};
+            switch (outcome) {
+                case TransferOutcome::Completed: ++stats_.completed; break;
+                case TransferOutcome::Failed: ++stats_.failed; break;
+                case TransferOutcome::TimedOut: ++stats_.timed_out; break;
+                case TransferOutcome::TooLarge: ++stats_.too_large; break;
+                case TransferOutcome::Cancelled: ++stats_.cancelled; break;
+            }
+            stats_.bytes += bytes;
+            stats_.connect_us += connect_us;
+            stats_.total_us += total_us;
+            stats_.max_total_us = std::max(stats_.max_total_us, total_us);
+            stats_.throttled_us += throttled_us;
+        }
+
+        TransferStats stats() const {
+            std::lock_guard<std::mutex> lock{mutex_};
+            return stats_;
+        }
+
+        void WriteStats(std::ostream &out) const {
+            auto const stats {this->stats()};
+            auto const transfers {stats.completed + stats.failed + stats.timed_out + stats.too_large + stats.cancelled};
+            rapidjson::OStreamWrapper stream{out};
+            rapidjson::Writer<rapidjson::OStreamWrapper> writer{stream};
+            writer.StartObject();
+            writer.Key("transfers");
+            writer.Uint64(transfers);
+            writer.Key("completed");
+            writer.Uint64(stats.completed);
+            writer.Key("failed");
+            writer.Uint64(stats.failed);
+            writer.Key("timed_out");
+            writer.Uint64(stats.timed_out);
+            writer.Key("too_large");
+            writer.Uint64(stats.too_large);
+            writer.Key("cancelled");
+            writer.Uint64(stats.cancelled);
+            writer.Key("bytes");
+            writer.Uint64(stats.bytes);
+            writer.Key("mean_connect_us");
+            writer.Double(transfers ? double(stats.connect_us) / transfers : 0.0);
+            writer.Key("mean_total_us");
+            writer.Double(transfers ? double(stats.total_us) / transfers : 0.0);
+            writer.Key("max_total_us");
+            writer.Uint64(stats.max_total_us);
+            writer.Key("throttled_us");
+            writer.Uint64(stats.throttled_us);
+            writer.EndObject();
+            writer.Flush();
+        }
+    };
+
+    struct FetchStats {
+        uint64_t requested{0};
+        // Network transfers started; requests for a URL already on its way share one.
+        uint64_t transfers{0};
+        uint64_t joined{0};
+        uint64_t fetched{0};
+        uint64_t failed{0};
+        uint64_t cancelled{0};
+        uint64_t reprioritized{0};
+        uint64_t max_in_flight{0};
+    };
+
+    // Fetches on a few worker threads, most urgent URL first; requests at `parked` wait until
+    // they are given a real priority. Requests for the same URL share a single transfer (a
+    // flight) ranked by its most urgent request, and all of them get the same bytes.
+    // Requests belong to an owner, which collects its results with Take() (the notify
+    // callback says when to look) and may cancel them all at once; Warm() requests only fill
+    // the resource cache. A transfer is aborted once none of its requests is left unparked,
+    // and the flight waits again if any of them remain.
+    class FetchPool {
+    public:
+        using TTicket = uint64_t;
+        using TBytes = ResourceCache::TBytes;
+        using TCancelled = std::function<bool()>;
+        using TFetch = std::function<std::string(std::string const &url, TCancelled const &cancelled)>;
+        using TNotify = std::function<void()>;
+
+        static constexpr int parked {std::numeric_limits<int>::max()};
+        // For Warm(): behind anything a visible widget asked for.
+        static constexpr int background {parked - 1};
+
+        struct Result {
+            TTicket ticket;
+            TBytes bytes;
+        };
+
+    private:
+        enum class State { Waiting, Running, Done };
+
+        struct Pending {
+            void const *owner;
+            std::string url;
+            int priority;
+            bool warm;
+            State state{State::Waiting};
+            TBytes bytes;
+        };
+
+        struct Flight {
+            bool running{false};
+            std::vector<TTicket> waiters;
+        };
+
+        using TFlights = std::map<std::string, Flight, std::less<>>;
+
+        mutable std::mutex mutex_;
+        std::condition_variable wake_;
+        std::map<TTicket, Pending> requests_;
+        TFlights flights_;
+        TTicket next_ticket_{1};
+        size_t in_flight_{0};
+        FetchStats stats_;
+        TFetch fetch_;
+        TNotify notify_;
+        bool stopping_{false};
+        std::vector<std::thread> workers_;
+
+        int Priority(Flight const &flight) const {
+            auto priority {parked};
+            for (auto const ticket: flight.waiters) {
+                priority = std::min(priority, requests_.at(ticket).priority);
+            }
+            return priority;
+        }
+
+        // The waiting flight with the most urgent request; ties go to the oldest request.
+        TFlights::iterator Next() {
+            auto next {flights_.end()};
+            std::pair<int, TTicket> next_rank {parked, 0};
+            for (auto pos {flights_.begin()}; pos != flights_.end(); ++pos) {
+                auto const &flight {pos->second};
+                if (flight.running || flight.waiters.empty()) {
+                    continue;
+                }
+                std::pair<int, TTicket> const rank {Priority(flight), flight.waiters.front()};
+                if (rank.first != parked && (next == flights_.end() || rank < next_rank)) {
+                    next = pos;
+                    next_rank = rank;
+                }
+            }
+            return next;
+        }
+
+        void SetState(Flight const &flight, State state) {
+            for (auto const ticket: flight.waiters) {
+                requests_.at(ticket).state = state;
+            }
+        }
+
+        void Remove(TTicket ticket) {
+            auto const pos {requests_.find(ticket)};
+            if (pos == requests_.end()) {
+                return;
+            }
+            auto const flight {flights_.find(pos->second.url)};
+            requests_.erase(pos);
+            if (flight == flights_.end()) {
+                return;
+            }
+            auto &waiters {flight->second.waiters};
+            waiters.erase(std::remove(waiters.begin(), waiters.end(), ticket), waiters.end());
+            if (waiters.empty() && !flight->second.running) {
+                flights_.erase(flight);
+            }
+        }
+
+        void Run() {
+            std::unique_lock<std::mutex> lock{mutex_};
+            for (;;) {
+                wake_.wait(lock, [this] { return stopping_ || Next() != flights_.end(); });
+                if (stopping_) {
+                    return;
+                }
+                auto const pos {Next()};
+                auto const url {pos->first};
+                auto const fetch {fetch_};
+                pos->second.running = true;
+                SetState(pos->second, State::Running);
+                ++stats_.transfers;
+                stats_.max_in_flight = std::max<uint64_t>(stats_.max_in_flight, ++in_flight_);
+                lock.unlock();
+
+                auto const cancelled {[this, &url] {
+                    std::lock_guard<std::mutex> lock{mutex_};
+                    auto const pos {flights_.find(url)};
+                    return stopping_ || pos == flights_.end() || Priority(pos->second) == parked;
+                }};
+                TBytes bytes;
+                auto aborted {false};
+                try {
+                    auto fetched {fetch ? fetch(url, cancelled) : std::string{}};
+                    aborted = cancelled();
+                    if (!fetched.empty() && !aborted) {
+                        bytes = ResourceCache::instance().Insert(url, std::move(fetched));
+                    }
+                }
+                catch (...) {
+                }
+
+                lock.lock();
+                --in_flight_;
+                auto const done {flights_.find(url)};
+                auto &flight {done->second};
+                flight.running = false;
+                if (aborted) {
+                    ++stats_.cancelled;
+                    SetState(flight, State::Waiting);
+                    if (flight.waiters.empty()) {
+                        flights_.erase(done);
+                    }
+                    continue;
+                }
+                ++(bytes ? stats_.fetched : stats_.failed);
+                auto delivered {false};
+                for (auto const ticket: flight.waiters) {
+                    auto &request {requests_.at(ticket)};
+                    if (request.warm) {
+                        requests_.erase(ticket);
+                        continue;
+                    }
+                    request.state = State::Done;
+                    request.bytes = bytes;
+                    delivered = true;
+                }
+                flights_.erase(done);
+                if (auto const notify {notify_}; notify && delivered) {
+                    lock.unlock();
+                    notify();
+                    lock.lock();
+                }
+            }
+        }
+
+        TTicket Add(void const *owner, std::string_view url, int priority, bool warm) {
+            TTicket ticket;
+            {
+                std::lock_guard<std::mutex> lock{mutex_};
+                ticket = next_ticket_++;
+                auto flight {flights_.find(url)};
+                if (flight == flights_.end()) {
+                    flight = flights_.emplace(std::string{url}, Flight{}).first;
+                }
+                else {
+                    ++stats_.joined;
+                }
+                flight->second.waiters.push_back(ticket);
+                requests_.emplace(ticket, Pending{owner, flight->first, priority, warm,
+                    flight->second.running ? State::Running : State::Waiting});
+                ++stats_.requested;
+            }
+            wake_.notify_one();
+            return ticket;
+        }
+
+    public:
+        explicit FetchPool(size_t workers, TFetch fetch = {}, TNotify notify = {}): fetch_{std::move(fetch)}, notify_{std::move(notify)} {
+            for (size_t i = 0; i < workers; ++i) {
+                workers_.emplace_back([this] { Run(); });
+            }
+        }
+        FetchPool(FetchPool const &) = delete;
+        FetchPool &operator=(FetchPool const &) = delete;
+
+        ~FetchPool() {
+            Shutdown();
+        }
+
+        static FetchPool &instance() {
+            static FetchPool pool {std::max<size_t>(fetch_limits().concurrency, 1)};
+            return pool;
+        }
+
+        void SetFetch(TFetch fetch) {
+            std::lock_guard<std::mutex> lock{mutex_};
+            fetch_ = std::move(fetch);
+        }
+
+        void SetNotify(TNotify notify) {
+            std::lock_guard<std::mutex> lock{mutex_};
+            notify_ = std::move(notify);
+        }
+
+        TTicket Request(void const *owner, std::string_view url, int priority) {
+            return Add(owner, url, priority, false);
+        }
+
+        // Fetches into the resource cache only; cancel with CancelOwner(owner).
+        void Warm(void const *owner, std::string_view url, int priority = background) {
+            Add(owner, url, priority, true);
+        }
+
+        void Reprioritize(TTicket ticket, int priority) {
+            {
+                std::lock_guard<std::mutex> lock{mutex_};
+                auto const pos {requests_.find(ticket)};
+                if (pos == requests_.end() || pos->second.priority == priority || pos->second.state == State::Done) {
+                    return;
+                }
+                ++stats_.reprioritized;
+                pos->second.priority = priority;
+            }
+            wake_.notify_one();
+        }
+
+        void Cancel(TTicket ticket) {
+            std::lock_guard<std::mutex> lock{mutex_};
+            Remove(ticket);
+        }
+
+        void CancelOwner(void const *owner) {
+            std::lock_guard<std::mutex> lock{mutex_};
+            std::vector<TTicket> tickets;
+            for (auto const &request: requests_) {
+                if (request.second.owner == owner) {
+                    tickets.push_back(request.first);
+                }
+            }
+            for (auto const ticket: tickets) {
+                Remove(ticket);
+            }
+        }
+
+        // Finished requests of `owner`; bytes are null when the fetch failed.
+        std::vector<Result> Take(void const *owner) {
+            std::vector<Result> results;
+            std::lock_guard<std::mutex> lock{mutex_};
+            for (auto pos {requests_.begin()}; pos != requests_.end();) {
+                if (pos->second.owner == owner && pos->second.state == State::Done) {
+                    results.push_back({pos->first, std::move(pos->second.bytes)});
+                    pos = requests_.erase(pos);
+                }
+                else {
+                    ++pos;
+                }
+            }
+            return results;
+        }
+
+        // Cached bytes, or a fetch on the calling thread; null when that fails.
+        TBytes FetchNow(std::string_view url) {
+            if (auto cached {ResourceCache::instance().Find(url)}) {
+                return cached;
+            }
+            TFetch fetch;
+            {
+                std::lock_guard<std::mutex> lock{mutex_};
+                fetch = fetch_;
+                ++stats_.requested;
+                ++stats_.transfers;
+            }
+            std::string const url_z {url};
+            auto fetched {fetch ? fetch(url_z, [] { return false; }) : std::string{}};
+            if (fetched.empty()) {
+                return nullptr;
+            }
+            return ResourceCache::instance().Insert(url, std::move(fetched));
+        }
+
+        void Shutdown() {
+            {
+                std::lock_guard<std::mutex> lock{mutex_};
+                stopping_ = true;
+            }
+            wake_.notify_all();
+            for (auto &worker: workers_) {
+                if (worker.joinable()) {
+                    worker.join();
+                }
+            }
+        }
+
+        FetchStats stats() const {
+            std::lock_guard<std::mutex> lock{mutex_};
+            return stats_;
+        }
+    };
+}
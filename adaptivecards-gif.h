@@ -0,0 +1,318 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include "adaptivecards-resample.h"
+
+namespace AdaptiveCards
+{
+    namespace detail {
+        inline int gif_u16(std::string_view bytes, size_t at) {
+            return uint8_t(bytes[at]) | uint8_t(bytes[at + 1]) << 8;
+        }
+
+        // Past the sub-block chain starting at `at`, or npos when it runs off the end.
+        inline size_t gif_skip_blocks(std::string_view bytes, size_t at) {
+            while (at < bytes.size()) {
+                auto const length {uint8_t(bytes[at])};
+                at += 1 + length;
+                if (length == 0) {
+                    return at;
+                }
+            }
+            return std::string_view::npos;
+        }
+
+        // Colour indices from the LZW sub-block chain `blocks`; fills at most out.size(), and
+        // leaves the rest of a short image as it was. False on a corrupt stream.
+        inline bool gif_lzw(std::string_view blocks, int min_code_size, std::vector<uint8_t> &out) {
+            if (min_code_size < 1 || min_code_size > 11) {
+                return false;
+            }
+            auto const clear {1 << min_code_size};
+            auto const end {clear + 1};
+            std::array<uint16_t, 4096> prefix;
+            std::array<uint8_t, 4096> suffix;
+            std::array<uint8_t, 4097> stack;
+            auto code_size {min_code_size + 1};
+            auto next {clear + 2};
+            auto previous {-1};
+            uint8_t first {0};
+            uint32_t bits {0};
+            auto count {0};
+            size_t written {0};
+            for (size_t at = 0; at < blocks.size();) {
+                auto const length {size_t(uint8_t(blocks[at++]))};
+                if (length == 0) {
+                    return true;
+                }
+                for (auto const byte: blocks.substr(at, length)) {
+                    bits |= uint32_t(uint8_t(byte)) << count;
+                    count += 8;
+                    while (count >= code_size) {
+                        auto code {int(bits & ((1u << code_size) - 1))};
+                        bits >>= code_size;
+                        count -= code_size;
+                        if (code == clear) {
+                            code_size = min_code_size + 1;
+                            next = clear + 2;
+                            previous = -1;
+                            continue;
+                        }
+                        if (code == end) {
+                            return true;
+                        }
+                        if (previous < 0) {
+                            if (code > clear) {
+                                return false;
+                            }
+                            if (written < out.size()) {
+                                out[written++] = uint8_t(code);
+                            }
+                            previous = code;
+                            first = uint8_t(code);
+                            continue;
+                        }
+                        auto const read {code};
+                        size_t depth {0};
+                        if (code >= next) {
+                            if (code > next) {
+                                return false;
+                            }
+                            stack[depth++] = first;
+                            code = previous;
+                        }
+                        while (code > end) {
+                            stack[depth++] = suffix[code];
+                            code = prefix[code];
+                        }
+                        stack[depth++] = uint8_t(code);
+                        first = uint8_t(code);
+                        for (; depth > 0 && written < out.size(); --depth) {
+                            out[written++] = stack[depth - 1];
+                        }
+                        if (next < 4096) {
+                            prefix[next] = uint16_t(previous);
+                            suffix[next] = first;
+                            if (++next == 1 << code_size && code_size < 12) {
+                                ++code_size;
+                            }
+                        }
+                        previous = read;
+                    }
+                }
+                at += length;
+            }
+            return true;
+        }
+    }
+
+    // A GIF, frames composited onto its logical screen in order and on demand: asking for a
+    // frame decodes only those since the last one asked for, or starts over from the first.
+    // The bytes must outlive the decoder. Frames after a corrupt one are dropped.
+    class GifDecoder {
+        struct FrameInfo {
+            int left;
+            int top;
+            int width;
+            int height;
+            std::chrono::milliseconds delay;
+            int disposal;
+            int transparent;
+            bool interlaced;
+            std::string_view palette;
+            int min_code_size;
+            std::string_view blocks;
+        };
+
+        // Larger logical screens are refused rather than allocated.
+        static constexpr int64_t max_pixels {1 << 24};
+
+        std::string_view bytes_;
+        int width_{0};
+        int height_{0};
+        int loops_{0};
+        std::vector<FrameInfo> frames_;
+        RgbaImage canvas_;
+        RgbaImage saved_;
+        std::vector<uint8_t> indices_;
+        size_t next_{0};
+
+        void Parse() {
+            if (bytes_.size() < 13 || (bytes_.substr(0, 6) != "GIF87a" && bytes_.substr(0, 6) != "GIF89a")) {
+                return;
+            }
+            auto const width {detail::gif_u16(bytes_, 6)};
+            auto const height {detail::gif_u16(bytes_, 8)};
+            auto const flags {uint8_t(bytes_[10])};
+            if (width == 0 || height == 0 || int64_t(width) * height > max_pixels) {
+                return;
+            }
+            size_t at {13};
+            std::string_view global;
+            if (flags & 0x80) {
+                auto const size {size_t(3) << ((flags & 7) + 1)};
+                global = bytes_.substr(at, size);
+                at += size;
+            }
+            // As browsers do, frames without a delay, or one of 10ms or less, play at 100ms.
+            auto delay {std::chrono::milliseconds{100}};
+            auto disposal {0};
+            auto transparent {-1};
+            while (at < bytes_.size()) {
+                auto const block {uint8_t(bytes_[at++])};
+                if (block == 0x3B) {
+                    break;
+                }
+                if (block == 0x21 && at < bytes_.size()) {
+                    auto const label {uint8_t(bytes_[at++])};
+                    if (label == 0xF9 && at + 6 <= bytes_.size() && bytes_[at] == 4) {
+                        auto const control {uint8_t(bytes_[at + 1])};
+                        disposal = (control >> 2) & 7;
+                        auto const hundredths {detail::gif_u16(bytes_, at + 2)};
+                        delay = std::chrono::milliseconds{hundredths <= 1 ? 100 : hundredths * 10};
+                        transparent = control & 1 ? uint8_t(bytes_[at + 4]) : -1;
+                    }
+                    else if (label == 0xFF && at + 16 <= bytes_.size() && bytes_.substr(at, 12) == "\x0BNETSCAPE2.0"
+                            && bytes_[at + 12] == 3 && bytes_[at + 13] == 1) {
+                        loops_ = detail::gif_u16(bytes_, at + 14);
+                    }
+                    at = detail::gif_skip_blocks(bytes_, at);
+                    continue;
+                }
+                if (block != 0x2C || at + 10 > bytes_.size()) {
+                    break;
+                }
+                FrameInfo frame {detail::gif_u16(bytes_, at), detail::gif_u16(bytes_, at + 2),
+                    detail::gif_u16(bytes_, at + 4), detail::gif_u16(bytes_, at + 6), delay, disposal, transparent,
+                    (bytes_[at + 8] & 0x40) != 0, global, 0, {}};
+                auto const local {uint8_t(bytes_[at + 8])};
+                at += 9;
+                if (local & 0x80) {
+                    auto const size {size_t(3) << ((local & 7) + 1)};
+                    frame.palette = bytes_.substr(std::min(at, bytes_.size()), size);
+                    at += size;
+                }
+                if (at >= bytes_.size() || frame.width == 0 || frame.height == 0) {
+                    break;
+                }
+                frame.min_code_size = uint8_t(bytes_[at++]);
+                auto const end {detail::gif_skip_blocks(bytes_, at)};
+                if (end == std::string_view::npos) {
+                    break;
+                }
+                frame.blocks = bytes_.substr(at, end - at);
+                frames_.push_back(frame);
+                at = end;
+                delay = std::chrono::milliseconds{100};
+                disposal = 0;
+                transparent = -1;
+            }
+            if (!frames_.empty()) {
+                width_ = width;
+                height_ = height;
+            }
+        }
+
+        // Undoes the previous frame as its disposal method asks, then draws the next one.
+        bool DecodeNext() {
+            if (next_ == 0) {
+                canvas_ = RgbaImage{width_, height_};
+            }
+            else {
+                auto const &previous {frames_[next_ - 1]};
+                if (previous.disposal == 2) {
+                    Clear(previous);
+                }
+                else if (previous.disposal == 3 && !saved_.empty()) {
+                    std::swap(canvas_, saved_);
+                }
+            }
+            auto const &frame {frames_[next_]};
+            if (frame.disposal == 3) {
+                saved_ = canvas_;
+            }
+            indices_.assign(size_t(frame.width) * frame.height, uint8_t(std::max(frame.transparent, 0)));
+            if (!detail::gif_lzw(frame.blocks, frame.min_code_size, indices_)) {
+                return false;
+            }
+            auto const colours {int(frame.palette.size() / 3)};
+            for (int row = 0; row < frame.height; ++row) {
+                auto const y {frame.top + (frame.interlaced ? InterlacedRow(row, frame.height) : row)};
+                if (y >= height_ || frame.left >= width_) {
+                    continue;
+                }
+                auto const in {indices_.data() + size_t(row) * frame.width};
+                auto out {canvas_.row(y) + size_t(frame.left) * 4};
+                for (int x = 0; x < frame.width && frame.left + x < width_; ++x, out += 4) {
+                    auto const index {int(in[x])};
+                    if (index == frame.transparent || index >= colours) {
+                        continue;
+                    }
+                    out[0] = uint8_t(frame.palette[index * 3]);
+                    out[1] = uint8_t(frame.palette[index * 3 + 1]);
+                    out[2] = uint8_t(frame.palette[index * 3 + 2]);
+                    out[3] = 0xFF;
+                }
+            }
+            ++next_;
+            return true;
+        }
+
+        void Clear(FrameInfo const &frame) {
+            for (auto y {frame.top}; y < std::min(height_, frame.top + frame.height); ++y) {
+                auto const right {std::min(width_, frame.left + frame.width)};
+                if (frame.left < right) {
+                    std::fill(canvas_.row(y) + size_t(frame.left) * 4, canvas_.row(y) + size_t(right) * 4, uint8_t(0));
+                }
+            }
+        }
+
+        // Interlaced rows arrive every 8th from 0, every 8th from 4, every 4th from 2, then
+        // every 2nd from 1; the canvas row of the `row`th to arrive.
+        static int InterlacedRow(int row, int height) {
+            for (auto const &pass: {std::make_pair(0, 8), std::make_pair(4, 8), std::make_pair(2, 4), std::make_pair(1, 2)}) {
+                auto const rows {(height - pass.first + pass.second - 1) / pass.second};
+                if (row < rows) {
+                    return pass.first + row * pass.second;
+                }
+                row -= std::max(rows, 0);
+            }
+            return 0;
+        }
+
+    public:
+        explicit GifDecoder(std::string_view bytes): bytes_{bytes} {
+            Parse();
+        }
+
+        bool empty() const { return frames_.empty(); }
+        bool animated() const { return frames_.size() > 1; }
+        size_t size() const { return frames_.size(); }
+        int width() const { return width_; }
+        int height() const { return height_; }
+        // Times the animation plays after the first; 0 for forever.
+        int loops() const { return loops_; }
+        std::chrono::milliseconds delay(size_t frame) const { return frames_[frame].delay; }
+
+        // The logical screen with frames up to `index` drawn; null when that frame is corrupt.
+        RgbaImage const *Frame(size_t index) {
+            if (index >= frames_.size()) {
+                return nullptr;
+            }
+            if (index < next_ - (next_ > 0)) {
+                next_ = 0;
+            }
+            while (next_ <= index) {
+                if (!DecodeNext()) {
+                    frames_.resize(next_);
+                    return nullptr;
+                }
+            }
+            return &canvas_;
+        }
+    };
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include "adaptivecards-core.h"
+
+namespace AdaptiveCards
+{
+    // Back/forward stack of visited cards. Entries near the current one keep their built view
+    // (hidden) so returning to them is a show; the rest keep only the compiled template and
+    // are rebuilt against freshly fetched data. Views are evicted farthest-first once there
+    // are more than `live_limit` of them or their estimated size exceeds `byte_budget`.
+    template <typename TView>
+    class History {
+    public:
+        struct Entry {
+            std::string locator;
+            std::string posted;
+            std::shared_ptr<Card> card;
+            TView view{};
+            size_t bytes{0};
+            int scroll{0};
+        };
+
+    private:
+        static constexpr size_t max_entries {64};
+
+        std::vector<Entry> entries_;
+        size_t current_{0};
+        size_t live_limit_;
+        size_t byte_budget_;
+
+        size_t distance(size_t index) const {
+            return index > current_ ? index - current_ : current_ - index;
+        }
+
+        template <typename TRelease>
+        void Drop(Entry &entry, TRelease &release) {
+            if (entry.view) {
+                release(entry.view);
+                entry.view = TView{};
+            }
+            entry.bytes = 0;
+            if (entry.card) {
+                entry.card->ReleaseData();
+            }
+        }
+
+    public:
+        History(size_t live_limit, size_t byte_budget): live_limit_{live_limit}, byte_budget_{byte_budget} {}
+
+        bool empty() const { return entries_.empty(); }
+        Entry *current() { return entries_.empty() ? nullptr : &entries_[current_]; }
+        bool can_back() const { return !entries_.empty() && current_ > 0; }
+        bool can_forward() const { return current_ + 1 < entries_.size(); }
+
+        size_t live() const {
+            return static_cast<size_t>(std::count_if(entries_.begin(), entries_.end(), [](Entry const &entry) { return entry.view; }));
+        }
+
+        size_t live_bytes() const {
+            size_t bytes {0};
+            for (auto const &entry: entries_) {
+                bytes += entry.bytes;
+            }
+            return bytes;
+        }
+
+        // Discards the forward entries and makes `entry` the current one.
+        template <typename TRelease>
+        Entry &Push(Entry &&entry, TRelease release) {
+            if (!entries_.empty()) {
+                for (auto index {current_ + 1}; index < entries_.size(); ++index) {
+                    Drop(entries_[index], release);
+                }
+                entries_.resize(current_ + 1);
+            }
+            entries_.push_back(std::move(entry));
+            if (entries_.size() > max_entries) {
+                Drop(entries_.front(), release);
+                entries_.erase(entries_.begin());
+            }
+            current_ = entries_.size() - 1;
+            Evict(release);
+            return entries_[current_];
+        }
+
+        Entry *Back() {
+            return can_back() ? &entries_[--current_] : nullptr;
+        }
+
+        Entry *Forward() {
+            return can_forward() ? &entries_[++current_] : nullptr;
+        }
+
+        template <typename TRelease>
+        void Evict(TRelease release) {
+            while (live() > live_limit_ || live_bytes() > byte_budget_) {
+                auto victim {entries_.size()};
+                for (size_t index = 0; index < entries_.size(); ++index) {
+                    if (index != current_ && entries_[index].view
+                            && (victim == entries_.size() || distance(index) > distance(victim))) {
+                        victim = index;
+                    }
+                }
+                if (victim == entries_.size()) {
+                    return;
+                }
+                Drop(entries_[victim], release);
+            }
+        }
+    };
+}
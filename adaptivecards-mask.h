@@ -0,0 +1,149 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "adaptivecards-resample.h"
+
+namespace AdaptiveCards
+{
+    // Coverage of a width x height image by the centred circle across its shorter side,
+    // one byte per pixel, sampled 4x4 per pixel along the edge.
+    inline std::vector<uint8_t> CircleMask(int width, int height) {
+        std::vector<uint8_t> mask(size_t(width) * height);
+        auto const radius {std::min(width, height) / 2.0};
+        auto const cx {width / 2.0};
+        auto const cy {height / 2.0};
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                auto const distance {std::hypot(x + 0.5 - cx, y + 0.5 - cy)};
+                uint8_t coverage {0};
+                if (distance <= radius - 1) {
+                    coverage = 255;
+                }
+                else if (distance < radius + 1) {
+                    int inside {0};
+                    for (int sy = 0; sy < 4; ++sy) {
+                        for (int sx = 0; sx < 4; ++sx) {
+                            inside += std::hypot(x + (sx + 0.5) / 4 - cx, y + (sy + 0.5) / 4 - cy) <= radius;
+                        }
+                    }
+                    coverage = uint8_t((inside * 255 + 8) / 16);
+                }
+                mask[size_t(y) * width + x] = coverage;
+            }
+        }
+        return mask;
+    }
+
+    // Circle masks by size, made once; shared by the decode workers. Avatars in a feed come
+    // in a handful of sizes, so the cache starts over rather than tracking use.
+    class MaskCache {
+    public:
+        using TMask = std::shared_ptr<std::vector<uint8_t> const>;
+
+    private:
+        static constexpr size_t capacity {32};
+
+        std::mutex mutex_;
+        std::map<std::pair<int, int>, TMask> masks_;
+
+    public:
+        static MaskCache &instance() {
+            static MaskCache cache;
+            return cache;
+        }
+
+        TMask Circle(int width, int height) {
+            std::lock_guard<std::mutex> lock{mutex_};
+            auto const key {std::make_pair(width, height)};
+            if (auto const pos {masks_.find(key)}; pos != masks_.end()) {
+                return pos->second;
+            }
+            if (masks_.size() >= capacity) {
+                masks_.clear();
+            }
+            return masks_[key] = std::make_shared<std::vector<uint8_t> const>(CircleMask(width, height));
+        }
+    };
+
+    // alpha = alpha * mask / 255 over `count` pixels, colour untouched.
+    namespace detail {
+        inline uint32_t div255(uint32_t value) {
+            value += 128;
+            return (value + (value >> 8)) >> 8;
+        }
+
+        inline void mask_scalar(uint8_t *pixels, uint8_t const *mask, size_t begin, size_t count) {
+            for (auto i {begin}; i < count; ++i) {
+                pixels[i * 4 + 3] = uint8_t(div255(uint32_t(pixels[i * 4 + 3]) * mask[i]));
+            }
+        }
+
+#ifdef ADAPTIVECARDS_RESAMPLE_X86
+        // Four pixels and their mask bytes, alpha in the top byte of each 32-bit lane.
+        inline __m128i mask_sse2(__m128i pixels, __m128i mask) {
+            auto const alpha {_mm_srli_epi32(pixels, 24)};
+            auto product {_mm_add_epi32(_mm_mullo_epi16(alpha, mask), _mm_set1_epi32(128))};
+            product = _mm_srli_epi32(_mm_add_epi32(product, _mm_srli_epi32(product, 8)), 8);
+            return _mm_or_si128(_mm_and_si128(pixels, _mm_set1_epi32(0x00FFFFFF)), _mm_slli_epi32(product, 24));
+        }
+
+        inline void apply_mask_sse2(uint8_t *pixels, uint8_t const *mask, size_t count) {
+            auto const zero {_mm_setzero_si128()};
+            size_t i {0};
+            for (; i + 16 <= count; i += 16) {
+                auto const bytes {_mm_loadu_si128(reinterpret_cast<__m128i const *>(mask + i))};
+                auto const low {_mm_unpacklo_epi8(bytes, zero)};
+                auto const high {_mm_unpackhi_epi8(bytes, zero)};
+                __m128i const words[4] {_mm_unpacklo_epi16(low, zero), _mm_unpackhi_epi16(low, zero),
+                    _mm_unpacklo_epi16(high, zero), _mm_unpackhi_epi16(high, zero)};
+                for (int k = 0; k < 4; ++k) {
+                    auto const at {reinterpret_cast<__m128i *>(pixels + (i + k * 4) * 4)};
+                    _mm_storeu_si128(at, mask_sse2(_mm_loadu_si128(at), words[k]));
+                }
+            }
+            mask_scalar(pixels, mask, i, count);
+        }
+
+        __attribute__((target("avx2")))
+        inline void apply_mask_avx2(uint8_t *pixels, uint8_t const *mask, size_t count) {
+            size_t i {0};
+            for (; i + 8 <= count; i += 8) {
+                auto const at {reinterpret_cast<__m256i *>(pixels + i * 4)};
+                auto const in {_mm256_loadu_si256(at)};
+                auto const words {_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<__m128i const *>(mask + i)))};
+                auto product {_mm256_add_epi32(_mm256_mullo_epi16(_mm256_srli_epi32(in, 24), words), _mm256_set1_epi32(128))};
+                product = _mm256_srli_epi32(_mm256_add_epi32(product, _mm256_srli_epi32(product, 8)), 8);
+                _mm256_storeu_si256(at, _mm256_or_si256(_mm256_and_si256(in, _mm256_set1_epi32(0x00FFFFFF)),
+                    _mm256_slli_epi32(product, 24)));
+            }
+            mask_scalar(pixels, mask, i, count);
+        }
+#endif
+    }
+
+    // Multiplies the image's alpha by `mask`, one byte per pixel of the same size.
+    inline void ApplyMask(RgbaImage &image, std::vector<uint8_t> const &mask, SimdLevel level = simd_level()) {
+        auto const count {size_t(image.width) * image.height};
+        if (mask.size() != count) {
+            return;
+        }
+        switch (std::min(level, simd_level())) {
+#ifdef ADAPTIVECARDS_RESAMPLE_X86
+            case SimdLevel::Avx2: detail::apply_mask_avx2(image.pixels.data(), mask.data(), count); break;
+            case SimdLevel::Sse2: detail::apply_mask_sse2(image.pixels.data(), mask.data(), count); break;
+#endif
+            default: detail::mask_scalar(image.pixels.data(), mask.data(), 0, count);
+        }
+    }
+
+    // Person style: the image cut to a circle, edges anti-aliased.
+    inline void ApplyCircle(RgbaImage &image) {
+        ApplyMask(image, *MaskCache::instance().Circle(image.width, image.height));
+    }
+}
@@ -0,0 +1,220 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "adaptivecards-core.h"
+#include "adaptivecards-fetch.h"
+
+namespace AdaptiveCards
+{
+    // Where the actions of a card lead: Action.OpenUrl targets, including those inside
+    // Action.ShowCard bodies, resolved against the card's data.
+    inline void CollectLocators(rapidjson::Value const &card, rapidjson::Value const *scope, std::vector<std::string> &locators) {
+        auto const actions {card.FindMember("actions")};
+        if (actions == card.MemberEnd() || !actions->value.IsArray()) {
+            return;
+        }
+        for (auto const &action: actions->value.GetArray()) {
+            auto const type {member_view(action, "type")};
+            if (type == "Action.OpenUrl") {
+                auto locator {interpolate(member_view(action, "url"), scope)};
+                if (!locator.empty() && std::find(locators.begin(), locators.end(), locator) == locators.end()) {
+                    locators.push_back(std::move(locator));
+                }
+            }
+            else if (type == "Action.ShowCard" && action.HasMember("card") && action["card"].IsObject()) {
+                CollectLocators(action["card"], scope, locators);
+            }
+        }
+    }
+
+    // Image URLs anywhere in a template, "$data" elements expanded; stops at `limit`.
+    inline void CollectImageUrls(rapidjson::Value const &element, rapidjson::Value const *scope, std::vector<std::string> &urls,
+            size_t limit, bool expand_data = true) {
+        if (urls.size() >= limit) {
+            return;
+        }
+        if (element.IsArray()) {
+            for (auto const &item: element.GetArray()) {
+                CollectImageUrls(item, scope, urls, limit);
+            }
+            return;
+        }
+        if (!element.IsObject()) {
+            return;
+        }
+        if (expand_data && element.HasMember("$data")) {
+            auto const items {scope ? resolve(*scope, binding_path(member_view(element, "$data"))) : nullptr};
+            if (items && items->IsArray()) {
+                for (auto const &item: items->GetArray()) {
+                    CollectImageUrls(element, &item, urls, limit, false);
+                }
+            }
+            return;
+        }
+        if (member_view(element, "type") == "Image") {
+            auto url {interpolate(member_view(element, "url"), scope)};
+            if (!url.empty() && std::find(urls.begin(), urls.end(), url) == urls.end()) {
+                urls.push_back(std::move(url));
+            }
+        }
+        for (auto const &member: element.GetObject()) {
+            CollectImageUrls(member.value, scope, urls, limit);
+        }
+    }
+
+    struct Prefetched {
+        std::shared_ptr<Card> card;
+        size_t bytes{0};
+    };
+
+    struct PrefetchStats {
+        uint64_t requested{0};
+        uint64_t completed{0};
+        uint64_t cancelled{0};
+        uint64_t over_budget{0};
+        uint64_t hits{0};
+        uint64_t misses{0};
+    };
+
+    // Loads likely next cards on `concurrency` worker threads. Each Request() or Cancel()
+    // starts a new generation: queued locators of older ones are dropped, and loads still in
+    // flight see `cancelled()` turn true and their results are discarded. Completed cards
+    // are kept up to `byte_budget` until taken or cancelled.
+    class Prefetcher {
+    public:
+        using TCancelled = std::function<bool()>;
+        using TLoad = std::function<Prefetched(std::string const &locator, TCancelled const &cancelled)>;
+
+    private:
+        std::mutex mutex_;
+        std::condition_variable wake_;
+        std::deque<std::pair<std::string, uint64_t>> queue_;
+        std::map<std::string, Prefetched, std::less<>> ready_;
+        std::vector<std::string> loading_;
+        std::atomic<uint64_t> generation_{0};
+        size_t ready_bytes_{0};
+        size_t byte_budget_;
+        PrefetchStats stats_;
+        TLoad load_;
+        bool stopping_{false};
+        std::vector<std::thread> workers_;
+
+        void Run() {
+            std::unique_lock<std::mutex> lock{mutex_};
+            for (;;) {
+                wake_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+                if (stopping_) {
+                    return;
+                }
+                auto job {std::move(queue_.front())};
+                queue_.pop_front();
+                if (job.second != generation_ || ready_.count(job.first)
+                        || std::find(loading_.begin(), loading_.end(), job.first) != loading_.end()) {
+                    continue;
+                }
+                loading_.push_back(job.first);
+                lock.unlock();
+                auto const cancelled {[this, generation = job.second] { return generation != generation_; }};
+                Prefetched result;
+                try {
+                    result = load_(job.first, cancelled);
+                }
+                catch (...) {
+                    result = {};
+                }
+                lock.lock();
+                loading_.erase(std::find(loading_.begin(), loading_.end(), job.first));
+                if (job.second != generation_ || !result.card) {
+                    ++stats_.cancelled;
+                }
+                else if (ready_bytes_ + result.bytes > byte_budget_) {
+                    ++stats_.over_budget;
+                }
+                else {
+                    ready_bytes_ += result.bytes;
+                    ready_.emplace(std::move(job.first), std::move(result));
+                    ++stats_.completed;
+                }
+            }
+        }
+
+    public:
+        Prefetcher(size_t concurrency, size_t byte_budget, TLoad load): byte_budget_{byte_budget}, load_{std::move(load)} {
+            for (size_t i = 0; i < concurrency; ++i) {
+                workers_.emplace_back([this] { Run(); });
+            }
+        }
+        Prefetcher(Prefetcher const &) = delete;
+        Prefetcher &operator=(Prefetcher const &) = delete;
+
+        ~Prefetcher() {
+            Shutdown();
+        }
+
+        // Drops whatever is queued or ready and starts loading `locators` in order.
+        void Request(std::vector<std::string> const &locators) {
+            {
+                std::lock_guard<std::mutex> lock{mutex_};
+                auto const generation {++generation_};
+                queue_.clear();
+                ready_.clear();
+                ready_bytes_ = 0;
+                for (auto const &locator: locators) {
+                    queue_.emplace_back(locator, generation);
+                    ++stats_.requested;
+                }
+            }
+            wake_.notify_all();
+        }
+
+        void Cancel() {
+            Request({});
+        }
+
+        // The prefetched card for `locator`, if it finished in time.
+        std::shared_ptr<Card> Take(std::string_view locator) {
+            std::lock_guard<std::mutex> lock{mutex_};
+            auto const pos {ready_.find(locator)};
+            if (pos == ready_.end()) {
+                ++stats_.misses;
+                return nullptr;
+            }
+            ++stats_.hits;
+            auto card {std::move(pos->second.card)};
+            ready_bytes_ -= pos->second.bytes;
+            ready_.erase(pos);
+            return card;
+        }
+
+        void Shutdown() {
+            {
+                std::lock_guard<std::mutex> lock{mutex_};
+                stopping_ = true;
+                ++generation_;
+            }
+            wake_.notify_all();
+            for (auto &worker: workers_) {
+                if (worker.joinable()) {
+                    worker.join();
+                }
+            }
+        }
+
+        PrefetchStats stats() {
+            std::lock_guard<std::mutex> lock{mutex_};
+            return stats_;
+        }
+    };
+}
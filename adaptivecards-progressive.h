@@ -0,0 +1,192 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "adaptivecards-alloc.h"
+#include "rapidjson/ostreamwrapper.h"
+#include "rapidjson/writer.h"
+
+namespace AdaptiveCards
+{
+    // What is built before a card's first paint and how the rest is spread over idle events.
+    struct ProgressiveConfig {
+        bool enabled{true};
+        // Top-level body elements always built up front; later containers are deferred.
+        size_t eager_elements{8};
+        // Time a single idle event may spend on deferred work.
+        std::chrono::microseconds slice{8000};
+        // How far off screen, in viewport heights, images are still fetched.
+        double image_lookahead{1.0};
+    };
+
+    inline ProgressiveConfig &progressive() {
+        static ProgressiveConfig config;
+        return config;
+    }
+
+    // Lower runs first.
+    enum class RenderPriority : int {
+        Image,
+        Deferred
+    };
+
+    struct ProgressStats {
+        double first_paint_us{0};
+        double complete_us{0};
+        uint64_t tasks{0};
+        uint64_t slices{0};
+        double max_slice_us{0};
+    };
+
+    // Deferred work of one card, run in priority order (then order queued) in time-boxed
+    // slices. Times are taken from Start(): first paint is reported by the view, completion
+    // is when the queue is empty and no outstanding work is left, either at the end of the
+    // slice that empties it or at the Settle() that finds the last outstanding work gone.
+    class RenderQueue {
+    public:
+        using TClock = std::chrono::steady_clock;
+        using TReport = std::function<void(ProgressStats const &stats)>;
+        // How much work outside the queue the card still waits for, e.g. image downloads.
+        using TOutstanding = std::function<size_t()>;
+
+    private:
+        struct Task {
+            RenderPriority priority;
+            uint64_t seq;
+            std::function<void()> run;
+
+            bool operator<(Task const &other) const {
+                // std::push_heap keeps the greatest on top; make that the earliest.
+                return std::make_pair(priority, seq) > std::make_pair(other.priority, other.seq);
+            }
+        };
+
+        std::vector<Task> heap_;
+        uint64_t next_seq_{0};
+        TClock::time_point started_{TClock::now()};
+        bool painted_{false};
+        bool complete_{false};
+        ProgressStats stats_;
+        TReport report_;
+        TOutstanding outstanding_;
+
+        void ReportIfDone() {
+            if (painted_ && complete_ && report_) {
+                auto const report {std::move(report_)};
+                report_ = nullptr;
+                report(stats_);
+            }
+        }
+
+        double since_start(TClock::time_point when) const {
+            return std::chrono::duration<double, std::micro>(when - started_).count();
+        }
+
+        void CompleteIfSettled(TClock::time_point when) {
+            if (!complete_ && heap_.empty() && (!outstanding_ || outstanding_() == 0)) {
+                complete_ = true;
+                stats_.complete_us = since_start(when);
+                ReportIfDone();
+            }
+        }
+
+    public:
+        // Times from `started`, when navigation to the card began, instead of from the queue's
+        // creation; work already deferred stays queued. `report` gets the stats once the card
+        // has painted and finished.
+        void Start(TClock::time_point started, TReport report = nullptr) {
+            started_ = started;
+            painted_ = false;
+            complete_ = false;
+            stats_ = {};
+            report_ = std::move(report);
+        }
+
+        void SetOutstanding(TOutstanding outstanding) {
+            outstanding_ = std::move(outstanding);
+        }
+
+        void Defer(RenderPriority priority, std::function<void()> task) {
+            heap_.push_back({priority, next_seq_++, std::move(task)});
+            std::push_heap(heap_.begin(), heap_.end());
+            complete_ = false;
+        }
+
+        bool empty() const { return heap_.empty(); }
+        size_t size() const { return heap_.size(); }
+
+        void Painted() {
+            if (!painted_) {
+                painted_ = true;
+                stats_.first_paint_us = since_start(TClock::now());
+                ReportIfDone();
+            }
+        }
+
+        // Completes the card once nothing is queued or outstanding; the view calls it when
+        // outstanding work may have finished.
+        void Settle() {
+            CompleteIfSettled(TClock::now());
+        }
+
+        // Runs tasks until the queue is empty or `budget` has passed; true when work remains.
+        bool RunSlice(std::chrono::microseconds budget) {
+            if (heap_.empty()) {
+                return false;
+            }
+            auto const start {TClock::now()};
+            auto const deadline {start + budget};
+            do {
+                std::pop_heap(heap_.begin(), heap_.end());
+                auto task {std::move(heap_.back().run)};
+                heap_.pop_back();
+                task();
+                ++stats_.tasks;
+            } while (!heap_.empty() && TClock::now() < deadline);
+            auto const end {TClock::now()};
+            ++stats_.slices;
+            stats_.max_slice_us = std::max(stats_.max_slice_us, std::chrono::duration<double, std::micro>(end - start).count());
+            CompleteIfSettled(end);
+            return !heap_.empty();
+        }
+
+        // Runs everything left, for callers that need the finished card.
+        void Drain() {
+            while (RunSlice(std::chrono::hours{1})) {
+            }
+        }
+
+        bool complete() const { return complete_; }
+        ProgressStats const &stats() const { return stats_; }
+    };
+
+    // The latest ProgressStats of each card, keyed by locator.
+    inline void WriteProgressStats(std::ostream &out, std::map<std::string, ProgressStats> const &cards) {
+        rapidjson::OStreamWrapper stream{out};
+        rapidjson::Writer<rapidjson::OStreamWrapper> writer{stream};
+        writer.StartObject();
+        for (auto const &card: cards) {
+            writer.Key(card.first.c_str());
+            writer.StartObject();
+            writer.Key("first_paint_us");
+            writer.Double(card.second.first_paint_us);
+            writer.Key("complete_us");
+            writer.Double(card.second.complete_us);
+            writer.Key("tasks");
+            writer.Uint64(card.second.tasks);
+            writer.Key("slices");
+            writer.Uint64(card.second.slices);
+            writer.Key("max_slice_us");
+            writer.Double(card.second.max_slice_us);
+            writer.EndObject();
+        }
+        writer.EndObject();
+        writer.Flush();
+    }
+}
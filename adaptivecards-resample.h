@@ -0,0 +1,310 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define ADAPTIVECARDS_RESAMPLE_X86 1
+#endif
+
+namespace AdaptiveCards
+{
+    // 8-bit RGBA, rows packed, alpha not premultiplied.
+    struct RgbaImage {
+        int width{0};
+        int height{0};
+        std::vector<uint8_t> pixels;
+
+        RgbaImage() = default;
+        RgbaImage(int width, int height): width{width}, height{height}, pixels(size_t(width) * height * 4) {}
+
+        bool empty() const { return pixels.empty(); }
+        size_t bytes() const { return pixels.size(); }
+        uint8_t *row(int y) { return pixels.data() + size_t(y) * width * 4; }
+        uint8_t const *row(int y) const { return pixels.data() + size_t(y) * width * 4; }
+    };
+
+    enum class ResampleFilter {
+        Bilinear,
+        Lanczos3
+    };
+
+    enum class SimdLevel {
+        Scalar,
+        Sse2,
+        Avx2
+    };
+
+    inline char const *simd_name(SimdLevel level) {
+        switch (level) {
+            case SimdLevel::Sse2: return "sse2";
+            case SimdLevel::Avx2: return "avx2";
+            default: return "scalar";
+        }
+    }
+
+    // The widest kernels this CPU runs. SSE2 is part of x86-64; AVX2 is checked once at run time.
+    inline SimdLevel simd_level() {
+#ifdef ADAPTIVECARDS_RESAMPLE_X86
+        static SimdLevel const level {__builtin_cpu_supports("avx2") ? SimdLevel::Avx2 : SimdLevel::Sse2};
+        return level;
+#else
+        return SimdLevel::Scalar;
+#endif
+    }
+
+    // Filter taps of a one-dimensional resample: output i reads `count` inputs from first[i].
+    struct ResampleTaps {
+        std::vector<int> first;
+        std::vector<float> weights;
+        int count{0};
+
+        float const *weights_of(int i) const { return weights.data() + size_t(i) * count; }
+    };
+
+    inline float lanczos3(float x) {
+        constexpr float pi {3.14159265358979f};
+        x = std::fabs(x);
+        if (x < 1e-6f) {
+            return 1;
+        }
+        if (x >= 3) {
+            return 0;
+        }
+        return 3 * std::sin(pi * x) * std::sin(pi * x / 3) / (pi * pi * x * x);
+    }
+
+    inline float triangle(float x) {
+        return std::max(0.0f, 1 - std::fabs(x));
+    }
+
+    // Taps widened by the scale factor when shrinking, so every input contributes.
+    inline ResampleTaps MakeTaps(ResampleFilter filter, int source, int target) {
+        ResampleTaps taps;
+        auto const support {filter == ResampleFilter::Lanczos3 ? 3.0f : 1.0f};
+        auto const kernel {filter == ResampleFilter::Lanczos3 ? &lanczos3 : &triangle};
+        auto const scale {float(target) / source};
+        auto const stretch {std::max(1.0f, 1 / scale)};
+        taps.count = std::min(source, int(std::ceil(support * stretch)) * 2 + 1);
+        taps.first.resize(target);
+        taps.weights.assign(size_t(target) * taps.count, 0);
+        for (int i = 0; i < target; ++i) {
+            auto const center {(i + 0.5f) / scale - 0.5f};
+            auto first {int(std::floor(center - support * stretch)) + 1};
+            first = std::clamp(first, 0, source - taps.count);
+            taps.first[i] = first;
+            auto const weights {taps.weights.data() + size_t(i) * taps.count};
+            float total {0};
+            for (int k = 0; k < taps.count; ++k) {
+                weights[k] = kernel((first + k - center) / stretch);
+                total += weights[k];
+            }
+            for (int k = 0; k < taps.count; ++k) {
+                weights[k] /= total;
+            }
+        }
+        return taps;
+    }
+
+    // Bytes of the intermediate rows Resample() holds besides its input and output.
+    inline size_t ResampleScratchBytes(RgbaImage const &source, int width) {
+        return size_t(source.height) * width * 4 * sizeof(float);
+    }
+
+    // The two passes of Resample(), once per instruction set: a row of 8-bit RGBA to
+    // premultiplied floats at the target width, then a weighted sum of such rows back to
+    // 8-bit straight alpha. All of them add taps in the same order.
+    namespace detail {
+        inline void horizontal_scalar(uint8_t const *in, float *out, ResampleTaps const &taps, int width) {
+            for (int x = 0; x < width; ++x, out += 4) {
+                auto const weights {taps.weights_of(x)};
+                auto pixel {in + size_t(taps.first[x]) * 4};
+                float r {0}, g {0}, b {0}, a {0};
+                for (int k = 0; k < taps.count; ++k, pixel += 4) {
+                    auto const wa {weights[k] * pixel[3]};
+                    r += wa * pixel[0];
+                    g += wa * pixel[1];
+                    b += wa * pixel[2];
+                    a += wa;
+                }
+                out[0] = r;
+                out[1] = g;
+                out[2] = b;
+                out[3] = a;
+            }
+        }
+
+        // Floats [begin, end) of one output row; the vector kernels finish their tails here.
+        inline void vertical_scalar(float const *first, size_t stride, float const *weights, int count,
+                size_t begin, size_t end, uint8_t *out) {
+            for (auto x {begin}; x < end; x += 4) {
+                float r {0}, g {0}, b {0}, a {0};
+                auto pixel {first + x};
+                for (int k = 0; k < count; ++k, pixel += stride) {
+                    r += weights[k] * pixel[0];
+                    g += weights[k] * pixel[1];
+                    b += weights[k] * pixel[2];
+                    a += weights[k] * pixel[3];
+                }
+                auto const alpha {std::clamp(a, 0.0f, 255.0f)};
+                auto const unpremultiply {alpha > 0 ? 1 / a : 0};
+                out[x + 0] = uint8_t(std::clamp(r * unpremultiply, 0.0f, 255.0f) + 0.5f);
+                out[x + 1] = uint8_t(std::clamp(g * unpremultiply, 0.0f, 255.0f) + 0.5f);
+                out[x + 2] = uint8_t(std::clamp(b * unpremultiply, 0.0f, 255.0f) + 0.5f);
+                out[x + 3] = uint8_t(alpha + 0.5f);
+            }
+        }
+
+#ifdef ADAPTIVECARDS_RESAMPLE_X86
+        // (r, g, b, a) -> (r/a, g/a, b/a, a), clamped and rounded to integers.
+        inline __m128i straight_sse2(__m128 pixel) {
+            auto const zero {_mm_setzero_ps()};
+            auto const alpha_lane {_mm_castsi128_ps(_mm_set_epi32(-1, 0, 0, 0))};
+            auto const alpha {_mm_shuffle_ps(pixel, pixel, _MM_SHUFFLE(3, 3, 3, 3))};
+            auto const unpremultiply {_mm_and_ps(_mm_div_ps(_mm_set1_ps(1), alpha), _mm_cmpgt_ps(alpha, zero))};
+            auto const factor {_mm_or_ps(_mm_andnot_ps(alpha_lane, unpremultiply), _mm_and_ps(alpha_lane, _mm_set1_ps(1)))};
+            auto const value {_mm_min_ps(_mm_max_ps(_mm_mul_ps(pixel, factor), zero), _mm_set1_ps(255))};
+            return _mm_cvttps_epi32(_mm_add_ps(value, _mm_set1_ps(0.5f)));
+        }
+
+        inline void store_sse2(__m128i const (&pixels)[4], uint8_t *out) {
+            auto const low {_mm_packs_epi32(pixels[0], pixels[1])};
+            auto const high {_mm_packs_epi32(pixels[2], pixels[3])};
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_packus_epi16(low, high));
+        }
+
+        // One pixel as (r*a, g*a, b*a, a).
+        inline __m128 premultiplied_sse2(uint8_t const *pixel) {
+            auto const zero {_mm_setzero_si128()};
+            int bytes;
+            std::memcpy(&bytes, pixel, 4);
+            auto const rgba {_mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero), zero))};
+            auto const alpha_lane {_mm_castsi128_ps(_mm_set_epi32(-1, 0, 0, 0))};
+            auto const alpha {_mm_shuffle_ps(rgba, rgba, _MM_SHUFFLE(3, 3, 3, 3))};
+            auto const factor {_mm_or_ps(_mm_andnot_ps(alpha_lane, alpha), _mm_and_ps(alpha_lane, _mm_set1_ps(1)))};
+            return _mm_mul_ps(rgba, factor);
+        }
+
+        inline void horizontal_sse2(uint8_t const *in, float *out, ResampleTaps const &taps, int width) {
+            for (int x = 0; x < width; ++x, out += 4) {
+                auto const weights {taps.weights_of(x)};
+                auto pixel {in + size_t(taps.first[x]) * 4};
+                auto sum {_mm_setzero_ps()};
+                for (int k = 0; k < taps.count; ++k, pixel += 4) {
+                    sum = _mm_add_ps(sum, _mm_mul_ps(premultiplied_sse2(pixel), _mm_set1_ps(weights[k])));
+                }
+                _mm_storeu_ps(out, sum);
+            }
+        }
+
+        // Four pixels per step, every tap row summed before the next four.
+        inline void vertical_sse2(float const *first, size_t stride, float const *weights, int count, uint8_t *out) {
+            size_t x {0};
+            for (; x + 16 <= stride; x += 16) {
+                __m128 sums[4] {_mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps()};
+                auto pixel {first + x};
+                for (int k = 0; k < count; ++k, pixel += stride) {
+                    auto const weight {_mm_set1_ps(weights[k])};
+                    for (int i = 0; i < 4; ++i) {
+                        sums[i] = _mm_add_ps(sums[i], _mm_mul_ps(_mm_loadu_ps(pixel + i * 4), weight));
+                    }
+                }
+                __m128i const packed[4] {straight_sse2(sums[0]), straight_sse2(sums[1]), straight_sse2(sums[2]), straight_sse2(sums[3])};
+                store_sse2(packed, out + x);
+            }
+            vertical_scalar(first, stride, weights, count, x, stride, out);
+        }
+
+        // Two taps per step: two adjacent pixels widen to eight floats.
+        __attribute__((target("avx2")))
+        inline void horizontal_avx2(uint8_t const *in, float *out, ResampleTaps const &taps, int width) {
+            auto const alpha_lanes {_mm256_castsi256_ps(_mm256_set_epi32(-1, 0, 0, 0, -1, 0, 0, 0))};
+            auto const one {_mm256_set1_ps(1)};
+            for (int x = 0; x < width; ++x, out += 4) {
+                auto const weights {taps.weights_of(x)};
+                auto pixel {in + size_t(taps.first[x]) * 4};
+                auto pairs {_mm256_setzero_ps()};
+                int k {0};
+                for (; k + 2 <= taps.count; k += 2, pixel += 8) {
+                    auto const rgba {_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<__m128i const *>(pixel))))};
+                    auto const alpha {_mm256_shuffle_ps(rgba, rgba, _MM_SHUFFLE(3, 3, 3, 3))};
+                    auto const factor {_mm256_blendv_ps(alpha, one, alpha_lanes)};
+                    auto const weight {_mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(weights[k])), _mm_set1_ps(weights[k + 1]), 1)};
+                    pairs = _mm256_add_ps(pairs, _mm256_mul_ps(_mm256_mul_ps(rgba, factor), weight));
+                }
+                auto sum {_mm_add_ps(_mm256_castps256_ps128(pairs), _mm256_extractf128_ps(pairs, 1))};
+                if (k < taps.count) {
+                    sum = _mm_add_ps(sum, _mm_mul_ps(premultiplied_sse2(pixel), _mm_set1_ps(weights[k])));
+                }
+                _mm_storeu_ps(out, sum);
+            }
+        }
+
+        // Eight pixels per step.
+        __attribute__((target("avx2")))
+        inline void vertical_avx2(float const *first, size_t stride, float const *weights, int count, uint8_t *out) {
+            size_t x {0};
+            for (; x + 32 <= stride; x += 32) {
+                __m256 sums[4] {_mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps()};
+                auto pixel {first + x};
+                for (int k = 0; k < count; ++k, pixel += stride) {
+                    auto const weight {_mm256_set1_ps(weights[k])};
+                    for (int i = 0; i < 4; ++i) {
+                        sums[i] = _mm256_add_ps(sums[i], _mm256_mul_ps(_mm256_loadu_ps(pixel + i * 8), weight));
+                    }
+                }
+                for (int half = 0; half < 2; ++half) {
+                    __m128i const packed[4] {
+                        straight_sse2(_mm256_castps256_ps128(sums[half * 2])),
+                        straight_sse2(_mm256_extractf128_ps(sums[half * 2], 1)),
+                        straight_sse2(_mm256_castps256_ps128(sums[half * 2 + 1])),
+                        straight_sse2(_mm256_extractf128_ps(sums[half * 2 + 1], 1))
+                    };
+                    store_sse2(packed, out + x + half * 16);
+                }
+            }
+            vertical_scalar(first, stride, weights, count, x, stride, out);
+        }
+#endif
+    }
+
+    // Separable resample in premultiplied alpha, so transparent pixels do not bleed colour.
+    // `level` picks the kernels; anything wider than the CPU supports falls back to simd_level().
+    inline RgbaImage Resample(RgbaImage const &source, int width, int height,
+            ResampleFilter filter = ResampleFilter::Lanczos3, SimdLevel level = simd_level()) {
+        if (source.empty() || width <= 0 || height <= 0) {
+            return {};
+        }
+        level = std::min(level, simd_level());
+        auto const horizontal {MakeTaps(filter, source.width, width)};
+        auto const vertical {MakeTaps(filter, source.height, height)};
+        auto const stride {size_t(width) * 4};
+        std::vector<float> rows(size_t(source.height) * stride);
+        for (int y = 0; y < source.height; ++y) {
+            auto const out {rows.data() + size_t(y) * stride};
+            switch (level) {
+#ifdef ADAPTIVECARDS_RESAMPLE_X86
+                case SimdLevel::Avx2: detail::horizontal_avx2(source.row(y), out, horizontal, width); break;
+                case SimdLevel::Sse2: detail::horizontal_sse2(source.row(y), out, horizontal, width); break;
+#endif
+                default: detail::horizontal_scalar(source.row(y), out, horizontal, width);
+            }
+        }
+        RgbaImage target{width, height};
+        for (int y = 0; y < height; ++y) {
+            auto const first {rows.data() + size_t(vertical.first[y]) * stride};
+            auto const weights {vertical.weights_of(y)};
+            switch (level) {
+#ifdef ADAPTIVECARDS_RESAMPLE_X86
+                case SimdLevel::Avx2: detail::vertical_avx2(first, stride, weights, vertical.count, target.row(y)); break;
+                case SimdLevel::Sse2: detail::vertical_sse2(first, stride, weights, vertical.count, target.row(y)); break;
+#endif
+                default: detail::vertical_scalar(first, stride, weights, vertical.count, 0, stride, target.row(y));
+            }
+        }
+        return target;
+    }
+}
@@ -0,0 +1,225 @@
+#pragma once
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "adaptivecards-alloc.h"
+#include "rapidjson/document.h"
+#include "rapidjson/error/en.h"
+#include "rapidjson/schema.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+
+namespace AdaptiveCards
+{
+    // The structure the element factories rely on, in JSON Schema draft 4: every element and
+    // action is an object with a string "type", and containers hold arrays of them. Unknown
+    // element types, extra members and "${...}" bindings are all allowed.
+    constexpr char card_schema[] {R"({
+        "type": "object",
+        "properties": {
+            "type": {"enum": ["AdaptiveCard"]},
+            "body": {"$ref": "#/definitions/elements"},
+            "actions": {"$ref": "#/definitions/actions"}
+        },
+        "definitions": {
+            "elements": {"type": "array", "items": {"$ref": "#/definitions/element"}},
+            "element": {
+                "type": "object",
+                "required": ["type"],
+                "properties": {
+                    "type": {"type": "string"},
+                    "$data": {"type": "string"},
+                    "$key": {"type": "string"},
+                    "id": {"type": "string"},
+                    "text": {"type": "string"},
+                    "url": {"type": "string"},
+                    "size": {"type": "string"},
+                    "weight": {"type": "string"},
+                    "style": {"type": "string"},
+                    "imageSize": {"type": "string"},
+                    "placeholder": {"type": "string"},
+                    "value": {"type": "string"},
+                    "isMultiline": {"type": "boolean"},
+                    "items": {"$ref": "#/definitions/elements"},
+                    "columns": {"type": "array", "items": {"$ref": "#/definitions/column"}},
+                    "images": {"type": "array", "items": {"$ref": "#/definitions/image"}},
+                    "facts": {"type": "array", "items": {"$ref": "#/definitions/pair"}},
+                    "choices": {"type": "array", "items": {"$ref": "#/definitions/pair"}},
+                    "actions": {"$ref": "#/definitions/actions"}
+                }
+            },
+            "column": {
+                "type": "object",
+                "properties": {
+                    "type": {"enum": ["Column"]},
+                    "$data": {"type": "string"},
+                    "items": {"$ref": "#/definitions/elements"}
+                }
+            },
+            "image": {
+                "type": "object",
+                "properties": {
+                    "$data": {"type": "string"},
+                    "url": {"type": "string"}
+                }
+            },
+            "pair": {
+                "type": "object",
+                "properties": {
+                    "$data": {"type": "string"},
+                    "title": {"type": "string"},
+                    "value": {"type": "string"}
+                }
+            },
+            "actions": {"type": "array", "items": {"$ref": "#/definitions/action"}},
+            "action": {
+                "type": "object",
+                "required": ["type"],
+                "properties": {
+                    "type": {"type": "string"},
+                    "id": {"type": "string"},
+                    "title": {"type": "string"},
+                    "url": {"type": "string"},
+                    "card": {"$ref": "#"}
+                }
+            }
+        }
+    })"};
+
+    struct SchemaConfig {
+        // Off, templates are only parsed; a malformed one still gets an error, not a crash.
+        bool enabled{true};
+        // Replaces the bundled schema, e.g. with the full published Adaptive Cards schema.
+        // Read once, when the first template is parsed.
+        std::string path;
+    };
+
+    inline SchemaConfig &schema_config() {
+        static SchemaConfig config;
+        return config;
+    }
+
+    // Parses card templates in place, validating against the schema in the same SAX pass.
+    // The compiled schema is immutable and shared by every thread; each parse has its own
+    // validator. Verdicts are remembered by source hash, so a template seen before is only
+    // parsed: valid ones skip the validator, invalid ones are not parsed again.
+    class TemplateParser {
+        struct Verdict {
+            bool valid;
+            std::string error;
+        };
+
+        static constexpr size_t capacity {256};
+
+        std::unique_ptr<rapidjson::SchemaDocument const> schema_;
+        std::mutex mutex_;
+        std::unordered_map<size_t, std::shared_ptr<Verdict const>> verdicts_;
+
+        explicit TemplateParser(std::string const &path) {
+            std::string text {card_schema};
+            if (!path.empty()) {
+                if (std::ifstream file{path}) {
+                    text.assign(std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{});
+                }
+            }
+            rapidjson::Document document;
+            if (document.Parse(text.data(), text.size()).HasParseError()) {
+                document.Parse(card_schema);
+            }
+            schema_ = std::make_unique<rapidjson::SchemaDocument const>(document);
+        }
+
+        std::shared_ptr<Verdict const> Find(size_t key) {
+            std::lock_guard<std::mutex> lock{mutex_};
+            auto const pos {verdicts_.find(key)};
+            return pos != verdicts_.end() ? pos->second : nullptr;
+        }
+
+        void Remember(size_t key, std::shared_ptr<Verdict const> verdict) {
+            std::lock_guard<std::mutex> lock{mutex_};
+            if (verdicts_.size() >= capacity) {
+                verdicts_.clear();
+            }
+            verdicts_[key] = std::move(verdict);
+        }
+
+        static std::string ParseError(rapidjson::ParseResult const &result) {
+            return std::string{rapidjson::GetParseError_En(result.Code())} + " at offset " + std::to_string(result.Offset());
+        }
+
+    public:
+        static TemplateParser &instance() {
+            static TemplateParser parser{schema_config().path};
+            return parser;
+        }
+
+        // Empty on success; otherwise what is wrong, and `doc` is left an empty object.
+        std::string Parse(std::string &source, rapidjson::Document &doc) {
+            auto const key {std::hash<std::string_view>{}(source)};
+            auto const known {schema_config().enabled ? Find(key) : nullptr};
+            std::string error;
+            if (known && !known->valid) {
+                error = known->error;
+            }
+            else if (known || !schema_config().enabled) {
+                if (doc.ParseInsitu(source.data()).HasParseError()) {
+                    error = ParseError(doc);
+                }
+            }
+            else {
+                rapidjson::InsituStringStream stream{source.data()};
+                rapidjson::SchemaValidatingReader<rapidjson::kParseInsituFlag, rapidjson::InsituStringStream, rapidjson::UTF8<>> reader{stream, *schema_};
+                doc.Populate(reader);
+                if (!reader.IsValid()) {
+                    rapidjson::StringBuffer pointer;
+                    reader.GetInvalidDocumentPointer().StringifyUriFragment(pointer);
+                    error = std::string{pointer.GetString()} + ": fails \"" + reader.GetInvalidSchemaKeyword() + "\"";
+                }
+                else if (reader.GetParseResult().IsError()) {
+                    error = ParseError(reader.GetParseResult());
+                }
+                // A parse error is as final as a schema violation, and just as cheap to remember.
+                Remember(key, std::make_shared<Verdict const>(Verdict{error.empty(), error}));
+            }
+            if (!error.empty() || !doc.IsObject()) {
+                if (error.empty()) {
+                    error = "the card is not an object";
+                }
+                doc.SetObject();
+            }
+            return error;
+        }
+    };
+
+    // A card with nothing but `message`, shown in place of one that failed to parse.
+    inline std::string ErrorCardTemplate(std::string_view message) {
+        rapidjson::StringBuffer buffer;
+        rapidjson::Writer<rapidjson::StringBuffer> writer{buffer};
+        writer.StartObject();
+        writer.Key("type");
+        writer.String("AdaptiveCard");
+        writer.Key("body");
+        writer.StartArray();
+        writer.StartObject();
+        writer.Key("type");
+        writer.String("TextBlock");
+        writer.Key("text");
+        writer.String("Invalid card template");
+        writer.Key("weight");
+        writer.String("Bolder");
+        writer.EndObject();
+        writer.StartObject();
+        writer.Key("type");
+        writer.String("TextBlock");
+        writer.Key("text");
+        writer.String(message.data(), rapidjson::SizeType(message.size()));
+        writer.EndObject();
+        writer.EndArray();
+        writer.EndObject();
+        return {buffer.GetString(), buffer.GetSize()};
+    }
+}
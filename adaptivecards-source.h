@@ -0,0 +1,244 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "adaptivecards-fetch.h"
+#include "adaptivecards-resample.h"
+#include "adaptivecards-trace.h"
+
+namespace AdaptiveCards
+{
+    // Image sources that need no network: "data:" URIs and "file://" paths. Both become
+    // bytes right away, "data:" payloads decoded, files mapped rather than read, and skip
+    // FetchPool and the resource cache; everything else still goes through curl.
+    namespace detail {
+        constexpr std::array<int8_t, 256> base64_table() {
+            std::array<int8_t, 256> table {};
+            for (auto &entry: table) {
+                entry = -1;
+            }
+            constexpr char alphabet[] {"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"};
+            for (int i = 0; i < 64; ++i) {
+                table[uint8_t(alphabet[i])] = int8_t(i);
+            }
+            return table;
+        }
+
+        // Decodes whole groups of four from `in`; stops before padding or the first invalid
+        // character and returns how much it consumed.
+        inline size_t base64_scalar(std::string_view in, uint8_t *&out) {
+            static constexpr auto table {base64_table()};
+            size_t i {0};
+            for (; i + 4 <= in.size(); i += 4) {
+                auto const a {table[uint8_t(in[i])]}, b {table[uint8_t(in[i + 1])]};
+                auto const c {table[uint8_t(in[i + 2])]}, d {table[uint8_t(in[i + 3])]};
+                if ((a | b | c | d) < 0) {
+                    break;
+                }
+                auto const group {uint32_t(a) << 18 | uint32_t(b) << 12 | uint32_t(c) << 6 | uint32_t(d)};
+                *out++ = uint8_t(group >> 16);
+                *out++ = uint8_t(group >> 8);
+                *out++ = uint8_t(group);
+            }
+            return i;
+        }
+
+#ifdef ADAPTIVECARDS_RESAMPLE_X86
+        // 32 characters to 24 bytes per step (W. Muła and D. Lemire, "Faster Base64 Encoding
+        // and Decoding Using AVX2 Instructions"): nibble lookups both validate and map ASCII
+        // to 6-bit values, then multiply-adds pack them. Writes 8 bytes past what it keeps.
+        __attribute__((target("avx2")))
+        inline size_t base64_avx2(std::string_view in, uint8_t *&out) {
+            auto const lut_lo {_mm256_setr_epi8(
+                0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+                0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A)};
+            auto const lut_hi {_mm256_setr_epi8(
+                0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+                0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10)};
+            auto const lut_roll {_mm256_setr_epi8(
+                0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+                0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0)};
+            auto const mask_2f {_mm256_set1_epi8(0x2F)};
+            auto const pack_shuffle {_mm256_setr_epi8(
+                2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1)};
+            auto const pack_lanes {_mm256_setr_epi32(0, 1, 2, 4, 5, 6, -1, -1)};
+            size_t i {0};
+            // Leaves the last group, which may be padded, to the scalar code.
+            for (; i + 36 <= in.size(); i += 32) {
+                auto text {_mm256_loadu_si256(reinterpret_cast<__m256i const *>(in.data() + i))};
+                auto const hi_nibbles {_mm256_and_si256(_mm256_srli_epi32(text, 4), mask_2f)};
+                auto const lo_nibbles {_mm256_and_si256(text, mask_2f)};
+                auto const hi {_mm256_shuffle_epi8(lut_hi, hi_nibbles)};
+                auto const lo {_mm256_shuffle_epi8(lut_lo, lo_nibbles)};
+                if (!_mm256_testz_si256(lo, hi)) {
+                    break;
+                }
+                auto const eq_2f {_mm256_cmpeq_epi8(text, mask_2f)};
+                auto const roll {_mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(eq_2f, hi_nibbles))};
+                text = _mm256_add_epi8(text, roll);
+                auto const pairs {_mm256_maddubs_epi16(text, _mm256_set1_epi32(0x01400140))};
+                auto const groups {_mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000))};
+                auto const packed {_mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(groups, pack_shuffle), pack_lanes)};
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), packed);
+                out += 24;
+            }
+            return i;
+        }
+#endif
+
+        inline int hex_digit(char c) {
+            if (c >= '0' && c <= '9') {
+                return c - '0';
+            }
+            if (c >= 'a' && c <= 'f') {
+                return c - 'a' + 10;
+            }
+            if (c >= 'A' && c <= 'F') {
+                return c - 'A' + 10;
+            }
+            return -1;
+        }
+    }
+
+    // Standard alphabet, with or without "=" padding; false on anything else.
+    inline bool Base64Decode(std::string_view in, std::string &out, SimdLevel level = simd_level()) {
+        while (!in.empty() && in.back() == '=') {
+            in.remove_suffix(1);
+        }
+        out.resize(in.size() / 4 * 3 + 32);
+        auto const begin {reinterpret_cast<uint8_t *>(out.data())};
+        auto end {begin};
+        size_t done {0};
+#ifdef ADAPTIVECARDS_RESAMPLE_X86
+        if (std::min(level, simd_level()) == SimdLevel::Avx2) {
+            done = detail::base64_avx2(in, end);
+        }
+#endif
+        done += detail::base64_scalar(in.substr(done), end);
+        auto const rest {in.substr(done)};
+        static constexpr auto table {detail::base64_table()};
+        uint32_t group {0};
+        for (auto const c: rest) {
+            if (table[uint8_t(c)] < 0) {
+                return false;
+            }
+            group = group << 6 | uint32_t(table[uint8_t(c)]);
+        }
+        switch (rest.size()) {
+            case 0:
+                break;
+            case 2:
+                *end++ = uint8_t(group >> 4);
+                break;
+            case 3:
+                *end++ = uint8_t(group >> 10);
+                *end++ = uint8_t(group >> 2);
+                break;
+            default:
+                return false;
+        }
+        out.resize(size_t(end - begin));
+        return true;
+    }
+
+    // "%xx" escapes; false on a broken one.
+    inline bool PercentDecode(std::string_view in, std::string &out) {
+        out.clear();
+        out.reserve(in.size());
+        for (size_t i = 0; i < in.size(); ++i) {
+            if (in[i] != '%') {
+                out.push_back(in[i]);
+                continue;
+            }
+            auto const high {i + 2 < in.size() ? detail::hex_digit(in[i + 1]) : -1};
+            auto const low {i + 2 < in.size() ? detail::hex_digit(in[i + 2]) : -1};
+            if (high < 0 || low < 0) {
+                return false;
+            }
+            out.push_back(char(high << 4 | low));
+            i += 2;
+        }
+        return true;
+    }
+
+    // "data:[<media type>][;base64],<payload>"
+    inline TBytes DataUriBytes(std::string_view uri) {
+        auto const comma {uri.find(',')};
+        if (uri.substr(0, 5) != "data:" || comma == std::string_view::npos) {
+            return nullptr;
+        }
+        auto const header {uri.substr(5, comma - 5)};
+        auto const payload {uri.substr(comma + 1)};
+        std::string bytes;
+        auto const base64 {header.size() >= 7 && header.substr(header.size() - 7) == ";base64"};
+        if (base64 ? !Base64Decode(payload, bytes) : !PercentDecode(payload, bytes)) {
+            return nullptr;
+        }
+        return SharedBytes(std::move(bytes));
+    }
+
+    // The whole file mapped read-only; unmapped when the last reference goes.
+    inline TBytes MapFile(std::string const &path) {
+        auto const fd {::open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+        if (fd < 0) {
+            return nullptr;
+        }
+        struct stat info;
+        void *address {MAP_FAILED};
+        if (::fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+            address = ::mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        ::close(fd);
+        if (address == MAP_FAILED) {
+            return nullptr;
+        }
+        struct Mapped {
+            std::string_view view;
+
+            ~Mapped() {
+                ::munmap(const_cast<char *>(view.data()), view.size());
+            }
+        };
+        auto mapped {std::make_shared<Mapped>()};
+        mapped->view = {static_cast<char const *>(address), size_t(info.st_size)};
+        return {mapped, &mapped->view};
+    }
+
+    // "file:///path" or "file://localhost/path".
+    inline TBytes FileUriBytes(std::string_view uri) {
+        if (uri.substr(0, 7) != "file://") {
+            return nullptr;
+        }
+        auto path {uri.substr(7)};
+        if (path.substr(0, 9) == "localhost") {
+            path.remove_prefix(9);
+        }
+        std::string decoded;
+        if (path.empty() || path.front() != '/' || !PercentDecode(path, decoded)) {
+            return nullptr;
+        }
+        return MapFile(decoded);
+    }
+
+    inline bool IsLocalSource(std::string_view url) {
+        return url.substr(0, 5) == "data:" || url.substr(0, 7) == "file://";
+    }
+
+    // Bytes of a "data:" or "file://" source; null for other schemes and for failures.
+    inline TBytes LocalSourceBytes(std::string_view url) {
+        AC_TRACE_SCOPE(ImageFetch, "local");
+        if (url.substr(0, 5) == "data:") {
+            return DataUriBytes(url);
+        }
+        return FileUriBytes(url);
+    }
+}
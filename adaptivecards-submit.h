@@ -0,0 +1,219 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "adaptivecards-core.h"
+#include "rapidjson/ostreamwrapper.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+
+namespace AdaptiveCards
+{
+    using TInputValues = std::vector<std::pair<std::string_view, std::string>>;
+
+    // The submit payload: the action's "data" members overlaid with the input values by id,
+    // written straight to JSON text.
+    inline std::string SerializeSubmit(rapidjson::Value const *data, TInputValues const &inputs) {
+        rapidjson::StringBuffer buffer;
+        rapidjson::Writer<rapidjson::StringBuffer> writer{buffer};
+        writer.StartObject();
+        if (data && data->IsObject()) {
+            for (auto const &member: data->GetObject()) {
+                auto const name {view(member.name)};
+                if (std::any_of(inputs.begin(), inputs.end(), [name](auto const &input) { return input.first == name; })) {
+                    continue;
+                }
+                writer.Key(name.data(), static_cast<rapidjson::SizeType>(name.size()));
+                member.value.Accept(writer);
+            }
+        }
+        for (auto const &input: inputs) {
+            writer.Key(input.first.data(), static_cast<rapidjson::SizeType>(input.first.size()));
+            writer.String(input.second.data(), static_cast<rapidjson::SizeType>(input.second.size()));
+        }
+        writer.EndObject();
+        return {buffer.GetString(), buffer.GetSize()};
+    }
+
+    using TSubmitSink = std::function<void(std::string_view action, std::string_view payload)>;
+
+    struct SubmitStats {
+        uint64_t submitted{0};
+        uint64_t coalesced{0};
+        uint64_t completed{0};
+        uint64_t failed{0};
+        uint64_t total_ns{0};
+        uint64_t max_ns{0};
+    };
+
+    // Hands submit payloads to the sink on a worker thread; Submit() only takes a short lock.
+    // A payload for an action that is still queued replaces the queued one, so a burst of
+    // clicks reaches the sink once with the latest inputs. Latency runs from the first
+    // queued submit to the sink returning.
+    class SubmitQueue {
+        struct Pending {
+            std::string action;
+            std::string payload;
+            std::chrono::steady_clock::time_point queued;
+        };
+
+        mutable std::mutex mutex_;
+        std::condition_variable wake_;
+        std::deque<Pending> pending_;
+        std::map<std::string, SubmitStats, std::less<>> stats_;
+        size_t max_depth_{0};
+        TSubmitSink sink_;
+        bool stopping_{false};
+        std::thread worker_;
+
+        SubmitStats &StatsFor(std::string_view action) {
+            auto pos {stats_.find(action)};
+            if (pos == stats_.end()) {
+                pos = stats_.emplace(std::string{action}, SubmitStats{}).first;
+            }
+            return pos->second;
+        }
+
+        void Run() {
+            std::unique_lock<std::mutex> lock{mutex_};
+            for (;;) {
+                wake_.wait(lock, [this] { return stopping_ || !pending_.empty(); });
+                if (pending_.empty()) {
+                    return;
+                }
+                auto request {std::move(pending_.front())};
+                pending_.pop_front();
+                auto const sink {sink_};
+                lock.unlock();
+                auto succeeded {true};
+                if (sink) {
+                    AC_TRACE_SCOPE(Submit, "sink");
+                    try {
+                        sink(request.action, request.payload);
+                    }
+                    catch (...) {
+                        succeeded = false;
+                    }
+                }
+                auto const latency {static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - request.queued).count())};
+                lock.lock();
+                auto &stats {StatsFor(request.action)};
+                ++(succeeded ? stats.completed : stats.failed);
+                stats.total_ns += latency;
+                stats.max_ns = std::max(stats.max_ns, latency);
+            }
+        }
+
+    public:
+        explicit SubmitQueue(TSubmitSink sink = {}): sink_{std::move(sink)}, worker_{[this] { Run(); }} {}
+        SubmitQueue(SubmitQueue const &) = delete;
+        SubmitQueue &operator=(SubmitQueue const &) = delete;
+
+        ~SubmitQueue() {
+            Shutdown();
+        }
+
+        static SubmitQueue &instance() {
+            static SubmitQueue queue;
+            return queue;
+        }
+
+        void SetSink(TSubmitSink sink) {
+            std::lock_guard<std::mutex> lock{mutex_};
+            sink_ = std::move(sink);
+        }
+
+        void Submit(std::string_view action, std::string &&payload) {
+            {
+                std::lock_guard<std::mutex> lock{mutex_};
+                auto &stats {StatsFor(action)};
+                ++stats.submitted;
+                auto const queued {std::find_if(pending_.begin(), pending_.end(), [action](Pending const &pending) {
+                    return pending.action == action;
+                })};
+                if (queued != pending_.end()) {
+                    queued->payload = std::move(payload);
+                    ++stats.coalesced;
+                    return;
+                }
+                pending_.push_back({std::string{action}, std::move(payload), std::chrono::steady_clock::now()});
+                max_depth_ = std::max(max_depth_, pending_.size());
+            }
+            wake_.notify_one();
+        }
+
+        // Delivers everything still queued, then stops the worker.
+        void Shutdown() {
+            {
+                std::lock_guard<std::mutex> lock{mutex_};
+                stopping_ = true;
+            }
+            wake_.notify_one();
+            if (worker_.joinable()) {
+                worker_.join();
+            }
+        }
+
+        size_t depth() const {
+            std::lock_guard<std::mutex> lock{mutex_};
+            return pending_.size();
+        }
+
+        size_t max_depth() const {
+            std::lock_guard<std::mutex> lock{mutex_};
+            return max_depth_;
+        }
+
+        std::map<std::string, SubmitStats, std::less<>> stats() const {
+            std::lock_guard<std::mutex> lock{mutex_};
+            return stats_;
+        }
+
+        void WriteStats(std::ostream &out) const {
+            std::lock_guard<std::mutex> lock{mutex_};
+            rapidjson::OStreamWrapper stream{out};
+            rapidjson::Writer<rapidjson::OStreamWrapper> writer{stream};
+            writer.StartObject();
+            writer.Key("depth");
+            writer.Uint64(pending_.size());
+            writer.Key("max_depth");
+            writer.Uint64(max_depth_);
+            writer.Key("actions");
+            writer.StartObject();
+            for (auto const &action: stats_) {
+                auto const &stats {action.second};
+                auto const delivered {stats.completed + stats.failed};
+                writer.Key(action.first.c_str());
+                writer.StartObject();
+                writer.Key("submitted");
+                writer.Uint64(stats.submitted);
+                writer.Key("coalesced");
+                writer.Uint64(stats.coalesced);
+                writer.Key("completed");
+                writer.Uint64(stats.completed);
+                writer.Key("failed");
+                writer.Uint64(stats.failed);
+                writer.Key("mean_latency_us");
+                writer.Double(delivered ? stats.total_ns / 1000.0 / delivered : 0.0);
+                writer.Key("max_latency_us");
+                writer.Double(stats.max_ns / 1000.0);
+                writer.EndObject();
+            }
+            writer.EndObject();
+            writer.EndObject();
+            writer.Flush();
+        }
+    };
+}
@@ -0,0 +1,192 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+namespace AdaptiveCards
+{
+    enum class Phase : uint8_t {
+        ProviderFetch,
+        TemplateParse,
+        WidgetFactory,
+        ResolveSinks,
+        ImageFetch,
+        ImageDecode,
+        ImageRescale,
+        Resize,
+        Submit,
+        Progressive,
+        Count
+    };
+
+    inline const char *phase_name(Phase phase) {
+        static const char *const names[] {
+            "provider", "parse", "factory", "bind", "image.fetch", "image.decode", "image.rescale", "resize", "submit", "progressive"
+        };
+        return phase < Phase::Count ? names[static_cast<size_t>(phase)] : "unknown";
+    }
+}
+
+#include "adaptivecards-alloc.h"
+
+#define AC_TRACE_JOIN2(a, b) a##b
+#define AC_TRACE_JOIN(a, b) AC_TRACE_JOIN2(a, b)
+
+#ifdef ADAPTIVECARDS_TRACE
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include "rapidjson/ostreamwrapper.h"
+#include "rapidjson/writer.h"
+
+namespace AdaptiveCards
+{
+    struct TraceCounter {
+        uint64_t count;
+        uint64_t total_ns;
+        uint64_t max_ns;
+    };
+
+    // Fixed-size ring of completed scopes. Writers claim a slot with one fetch_add and
+    // publish it through the slot's sequence number (a seqlock: odd while the fields are
+    // written, even once they are); readers skip slots being rewritten.
+    class TraceBuffer {
+        static constexpr size_t capacity {1 << 14};
+
+        struct Slot {
+            std::atomic<uint64_t> sequence{0};
+            std::atomic<const char *> name{nullptr};
+            std::atomic<Phase> phase{Phase::Count};
+            std::atomic<uint32_t> thread{0};
+            std::atomic<int64_t> start_ns{0};
+            std::atomic<int64_t> duration_ns{0};
+        };
+
+        struct Counter {
+            std::atomic<uint64_t> count{0};
+            std::atomic<uint64_t> total_ns{0};
+            std::atomic<uint64_t> max_ns{0};
+        };
+
+        std::array<Slot, capacity> slots_;
+        std::atomic<uint64_t> next_{0};
+        std::array<Counter, static_cast<size_t>(Phase::Count)> counters_;
+        std::chrono::steady_clock::time_point const epoch_{std::chrono::steady_clock::now()};
+
+        static uint32_t thread_index() {
+            static std::atomic<uint32_t> threads{0};
+            thread_local uint32_t const index {++threads};
+            return index;
+        }
+
+    public:
+        static TraceBuffer &instance() {
+            static TraceBuffer buffer;
+            return buffer;
+        }
+
+        int64_t now() const {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch_).count();
+        }
+
+        void Record(Phase phase, const char *name, int64_t start_ns, int64_t duration_ns) {
+            auto const index {next_.fetch_add(1, std::memory_order_relaxed)};
+            auto &slot {slots_[index % capacity]};
+            slot.sequence.store(index * 2 + 1, std::memory_order_relaxed);
+            // Keeps the field stores below from becoming visible before the odd sequence.
+            std::atomic_thread_fence(std::memory_order_release);
+            slot.name.store(name, std::memory_order_relaxed);
+            slot.phase.store(phase, std::memory_order_relaxed);
+            slot.thread.store(thread_index(), std::memory_order_relaxed);
+            slot.start_ns.store(start_ns, std::memory_order_relaxed);
+            slot.duration_ns.store(duration_ns, std::memory_order_relaxed);
+            slot.sequence.store(index * 2 + 2, std::memory_order_release);
+
+            auto &counter {counters_[static_cast<size_t>(phase)]};
+            counter.count.fetch_add(1, std::memory_order_relaxed);
+            counter.total_ns.fetch_add(static_cast<uint64_t>(duration_ns), std::memory_order_relaxed);
+            auto max {counter.max_ns.load(std::memory_order_relaxed)};
+            while (static_cast<uint64_t>(duration_ns) > max
+                && !counter.max_ns.compare_exchange_weak(max, static_cast<uint64_t>(duration_ns), std::memory_order_relaxed)) {
+            }
+        }
+
+        TraceCounter counter(Phase phase) const {
+            auto const &counter {counters_[static_cast<size_t>(phase)]};
+            return {counter.count.load(std::memory_order_relaxed),
+                counter.total_ns.load(std::memory_order_relaxed),
+                counter.max_ns.load(std::memory_order_relaxed)};
+        }
+
+        void WriteChromeTrace(std::ostream &out) const {
+            rapidjson::OStreamWrapper stream{out};
+            rapidjson::Writer<rapidjson::OStreamWrapper> writer{stream};
+            writer.StartObject();
+            writer.Key("traceEvents");
+            writer.StartArray();
+            auto const end {next_.load(std::memory_order_acquire)};
+            for (auto index {end > capacity ? end - capacity : 0}; index < end; ++index) {
+                auto const &slot {slots_[index % capacity]};
+                auto const sequence {slot.sequence.load(std::memory_order_acquire)};
+                if (sequence != index * 2 + 2) {
+                    continue;
+                }
+                auto const name {slot.name.load(std::memory_order_relaxed)};
+                auto const phase {slot.phase.load(std::memory_order_relaxed)};
+                auto const thread {slot.thread.load(std::memory_order_relaxed)};
+                auto const start_ns {slot.start_ns.load(std::memory_order_relaxed)};
+                auto const duration_ns {slot.duration_ns.load(std::memory_order_relaxed)};
+                // Pairs with the writer's fence: a field read that saw a rewrite also sees its odd sequence.
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (slot.sequence.load(std::memory_order_relaxed) != sequence) {
+                    continue;
+                }
+                writer.StartObject();
+                writer.Key("name");
+                writer.String(name ? name : phase_name(phase));
+                writer.Key("cat");
+                writer.String(phase_name(phase));
+                writer.Key("ph");
+                writer.String("X");
+                writer.Key("ts");
+                writer.Double(start_ns / 1000.0);
+                writer.Key("dur");
+                writer.Double(duration_ns / 1000.0);
+                writer.Key("pid");
+                writer.Uint(1);
+                writer.Key("tid");
+                writer.Uint(thread);
+                writer.EndObject();
+            }
+            writer.EndArray();
+            writer.Key("displayTimeUnit");
+            writer.String("ms");
+            writer.EndObject();
+            writer.Flush();
+        }
+    };
+
+    class TraceScope {
+        Phase const phase_;
+        const char *const name_;
+        int64_t const start_ns_;
+    public:
+        TraceScope(Phase phase, const char *name)
+            : phase_{phase}, name_{name}, start_ns_{TraceBuffer::instance().now()} {}
+        ~TraceScope() {
+            auto &buffer {TraceBuffer::instance()};
+            buffer.Record(phase_, name_, start_ns_, buffer.now() - start_ns_);
+        }
+        TraceScope(TraceScope const &) = delete;
+        TraceScope &operator=(TraceScope const &) = delete;
+    };
+}
+
+#define AC_TRACE_EVENT(phase, name) \
+    ::AdaptiveCards::TraceScope AC_TRACE_JOIN(ac_trace_scope_, __LINE__) {::AdaptiveCards::Phase::phase, name};
+#else
+#define AC_TRACE_EVENT(phase, name)
+#endif
+
+// Times the enclosing scope and attributes its heap allocations to `phase`.
+#define AC_TRACE_SCOPE(phase, name) AC_TRACE_EVENT(phase, name) AC_ALLOC_SCOPE(phase, name)
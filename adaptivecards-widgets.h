@@ -0,0 +1,1617 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <future>
+#include <list>
+#include <map>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <wx/wx.h>
+#include <wx/scrolwin.h>
+#include <wx/dcclient.h>
+#include <wx/dcmemory.h>
+#include <wx/timer.h>
+#include <wx/vlbox.h>
+#include <wx/mstream.h>
+#include "adaptivecards-core.h"
+#include "adaptivecards-choices.h"
+#include "adaptivecards-submit.h"
+#include "adaptivecards-progressive.h"
+#include "adaptivecards-fetch.h"
+#include "adaptivecards-decodepool.h"
+#include "adaptivecards-gif.h"
+#include "adaptivecards-source.h"
+#include "adaptivecards-trace.h"
+
+namespace AdaptiveCards
+{
+    inline wxString to_wx(std::string_view text) {
+        return wxString::FromUTF8(text.data(), text.size());
+    }
+
+    using TResize = std::function<void(int)>;
+    using TAddWidget = std::function<void(wxWindow *)>;
+    // Builds a template's widgets under `parent`, collecting its bindings into `expr`.
+    using TMaterialize = std::function<TResize(wxWindow *parent, ExpressionSet const &expr, TAddWidget add)>;
+
+    // The scrolled area a card is shown in. Widgets that only do work for what is on screen
+    // listen to it; listeners run once per batch of scroll and size changes. Work deferred
+    // past the first paint runs from its idle events, one time-boxed slice each, and so do
+    // the callbacks of fetches and image decodes made through it. Its animations share one
+    // timer, which stops while the card is hidden or its window minimized.
+    class CardViewport : public wxScrolledWindow {
+    public:
+        using TFetched = std::function<void(FetchPool::TBytes const &bytes)>;
+        using TDecoded = std::function<void(DecodePool::TImage const &image)>;
+        using TClock = std::chrono::steady_clock;
+        // Shows the frame due at `now` and returns when the next one is, or
+        // TClock::time_point::max() when there is none or the animation is off screen.
+        using TAnimate = std::function<TClock::time_point(TClock::time_point now)>;
+
+    private:
+        // Frames due this close together are shown on the same tick.
+        static constexpr std::chrono::milliseconds animation_slack {10};
+
+        struct Fetching {
+            TFetched fetched;
+            bool parked;
+        };
+
+        std::map<int, std::function<void()>> listeners_;
+        int next_listener_{0};
+        bool pending_{false};
+        RenderQueue queue_;
+        std::map<FetchPool::TTicket, Fetching> fetches_;
+        std::map<DecodePool::TTicket, TDecoded> decodes_;
+        std::map<int, TAnimate> animations_;
+        int next_animation_{0};
+        wxTimer animation_timer_;
+        wxWindow *top_{nullptr};
+#ifdef ADAPTIVECARDS_ALLOC_TRACKING
+        // The card being built when this viewport was made, so deferred work counts for it.
+        AllocCounters *alloc_card_{AllocTracker::context().card};
+#endif
+
+        bool Minimized() const {
+            auto const top {dynamic_cast<wxTopLevelWindow *>(top_)};
+            return top && top->IsIconized();
+        }
+
+        // Advances every animation and sleeps until the earliest next frame.
+        void Tick() {
+            animation_timer_.Stop();
+            if (animations_.empty() || !IsShownOnScreen() || Minimized()) {
+                return;
+            }
+            auto const now {TClock::now()};
+            auto next {TClock::time_point::max()};
+            for (auto const &animation: animations_) {
+                next = std::min(next, animation.second(now + animation_slack));
+            }
+            if (next != TClock::time_point::max()) {
+                auto const wait {std::chrono::duration_cast<std::chrono::milliseconds>(next - now)};
+                animation_timer_.StartOnce(std::max(1, int(wait.count())));
+            }
+        }
+
+        void OnIconize(wxIconizeEvent &event) {
+            event.Skip();
+            Tick();
+        }
+
+        void OnScroll(wxScrollWinEvent &event) {
+            event.Skip();
+            Changed();
+        }
+
+        void OnPaint(wxPaintEvent &event) {
+            event.Skip();
+            queue_.Painted();
+        }
+
+        void OnIdle(wxIdleEvent &event) {
+            event.Skip();
+            AC_ALLOC_CARD(alloc_card_);
+            if (!fetches_.empty()) {
+                for (auto &result: FetchPool::instance().Take(this)) {
+                    auto const pos {fetches_.find(result.ticket)};
+                    if (pos != fetches_.end()) {
+                        auto const fetched {std::move(pos->second.fetched)};
+                        fetches_.erase(pos);
+                        fetched(result.bytes);
+                    }
+                }
+            }
+            if (!decodes_.empty()) {
+                for (auto &result: DecodePool::instance().Take(this)) {
+                    auto const pos {decodes_.find(result.ticket)};
+                    if (pos != decodes_.end()) {
+                        auto const decoded {std::move(pos->second)};
+                        decodes_.erase(pos);
+                        decoded(result.image);
+                    }
+                }
+            }
+            queue_.Settle();
+            if (queue_.empty()) {
+                return;
+            }
+            bool more;
+            {
+                AC_TRACE_SCOPE(Progressive, "slice");
+                more = queue_.RunSlice(progressive().slice);
+            }
+            Layout();
+            FitInside();
+            Changed();
+            if (more) {
+                event.RequestMore();
+            }
+        }
+
+    public:
+        explicit CardViewport(wxWindow *parent): wxScrolledWindow(parent, wxID_ANY) {
+            SetScrollRate(0, 10);
+            queue_.SetOutstanding([this] { return Outstanding(); });
+            for (auto const type: {wxEVT_SCROLLWIN_TOP, wxEVT_SCROLLWIN_BOTTOM, wxEVT_SCROLLWIN_LINEUP,
+                    wxEVT_SCROLLWIN_LINEDOWN, wxEVT_SCROLLWIN_PAGEUP, wxEVT_SCROLLWIN_PAGEDOWN,
+                    wxEVT_SCROLLWIN_THUMBTRACK, wxEVT_SCROLLWIN_THUMBRELEASE}) {
+                Bind(type, &CardViewport::OnScroll, this);
+            }
+            Bind(wxEVT_PAINT, &CardViewport::OnPaint, this);
+            Bind(wxEVT_IDLE, &CardViewport::OnIdle, this);
+            animation_timer_.SetOwner(this);
+            Bind(wxEVT_TIMER, [this](wxTimerEvent &) { Tick(); });
+            top_ = wxGetTopLevelParent(parent);
+            if (top_) {
+                top_->Bind(wxEVT_ICONIZE, &CardViewport::OnIconize, this);
+            }
+        }
+
+        ~CardViewport() override {
+            animation_timer_.Stop();
+            if (top_) {
+                top_->Unbind(wxEVT_ICONIZE, &CardViewport::OnIconize, this);
+            }
+            DestroyChildren();
+            FetchPool::instance().CancelOwner(this);
+            DecodePool::instance().CancelOwner(this);
+        }
+
+        static CardViewport *Of(wxWindow *window) {
+            for (; window; window = window->GetParent()) {
+                if (auto const viewport {dynamic_cast<CardViewport *>(window)}) {
+                    return viewport;
+                }
+            }
+            return nullptr;
+        }
+
+        RenderQueue &queue() { return queue_; }
+
+#ifdef ADAPTIVECARDS_ALLOC_TRACKING
+        AllocCounters *alloc_card() const { return alloc_card_; }
+
+        static AllocCounters *AllocCardOf(wxWindow *window) {
+            auto const viewport {Of(window)};
+            return viewport ? viewport->alloc_card() : nullptr;
+        }
+#endif
+
+        FetchPool::TTicket Fetch(std::string_view url, int priority, TFetched fetched) {
+            auto const ticket {FetchPool::instance().Request(this, url, priority)};
+            fetches_.emplace(ticket, Fetching{std::move(fetched), priority == FetchPool::parked});
+            return ticket;
+        }
+
+        void Reprioritize(FetchPool::TTicket ticket, int priority) {
+            FetchPool::instance().Reprioritize(ticket, priority);
+            if (auto const pos {fetches_.find(ticket)}; pos != fetches_.end()) {
+                pos->second.parked = priority == FetchPool::parked;
+            }
+        }
+
+        void CancelFetch(FetchPool::TTicket ticket) {
+            FetchPool::instance().Cancel(ticket);
+            fetches_.erase(ticket);
+        }
+
+        DecodePool::TTicket Decode(std::string_view url, FetchPool::TBytes bytes, int width, bool circular, int priority, TDecoded decoded) {
+            auto const ticket {DecodePool::instance().Request(this, url, std::move(bytes), width, priority, circular)};
+            decodes_.emplace(ticket, std::move(decoded));
+            return ticket;
+        }
+
+        DecodePool::TTicket Shrink(std::string_view url, DecodePool::TImage source, int width, bool circular, int priority, TDecoded decoded) {
+            auto const ticket {DecodePool::instance().Shrink(this, url, std::move(source), width, priority, circular)};
+            decodes_.emplace(ticket, std::move(decoded));
+            return ticket;
+        }
+
+        void CancelDecode(DecodePool::TTicket ticket) {
+            DecodePool::instance().Cancel(ticket);
+            decodes_.erase(ticket);
+        }
+
+        // Fetches and decodes the card still waits for. Parked fetches wait on scrolling, not
+        // on the card, so they do not count.
+        size_t Outstanding() const {
+            auto count {decodes_.size()};
+            for (auto const &fetch: fetches_) {
+                count += fetch.second.parked ? 0 : 1;
+            }
+            return count;
+        }
+
+        int Listen(std::function<void()> listener) {
+            listeners_.emplace(next_listener_, std::move(listener));
+            return next_listener_++;
+        }
+
+        void Unlisten(int listener) {
+            listeners_.erase(listener);
+        }
+
+        // Animations are ticked again after every batch of changes, so one scrolled into
+        // view resumes and one scrolled out stops asking for frames.
+        int Animate(TAnimate animate) {
+            animations_.emplace(next_animation_, std::move(animate));
+            Tick();
+            return next_animation_++;
+        }
+
+        void StopAnimating(int animation) {
+            animations_.erase(animation);
+            if (animations_.empty()) {
+                animation_timer_.Stop();
+            }
+        }
+
+        void Changed() {
+            if (pending_) {
+                return;
+            }
+            pending_ = true;
+            CallAfter([this] {
+                AC_ALLOC_CARD(alloc_card_);
+                pending_ = false;
+                auto const listeners {listeners_};
+                for (auto const &listener: listeners) {
+                    listener.second();
+                }
+                Tick();
+            });
+        }
+
+        // The part of `window` currently scrolled into view, in `window` client coordinates.
+        wxRect VisiblePart(wxWindow *window) const {
+            auto const origin {window->ClientToScreen(wxPoint{0, 0})};
+            auto const view_origin {ClientToScreen(wxPoint{0, 0})};
+            auto const view_size {GetClientSize()};
+            auto const size {window->GetClientSize()};
+            auto const left {std::max(0, view_origin.x - origin.x)};
+            auto const top {std::max(0, view_origin.y - origin.y)};
+            auto const right {std::min(size.GetWidth(), view_origin.x + view_size.GetWidth() - origin.x)};
+            auto const bottom {std::min(size.GetHeight(), view_origin.y + view_size.GetHeight() - origin.y)};
+            return {left, top, std::max(0, right - left), std::max(0, bottom - top)};
+        }
+
+        // Vertical pixels between `window` and the part of the card in view; 0 when they overlap.
+        int Distance(wxWindow *window) const {
+            return Distance(window, wxRect{wxPoint{0, 0}, window->GetClientSize()});
+        }
+
+        // The same for `part` of `window`, in its client coordinates.
+        int Distance(wxWindow *window, wxRect const &part) const {
+            auto const top {window->ClientToScreen(part.GetPosition()).y};
+            auto const bottom {top + part.GetHeight()};
+            auto const view_top {ClientToScreen(wxPoint{0, 0}).y};
+            auto const view_bottom {view_top + GetClientSize().GetHeight()};
+            return std::max({0, top - view_bottom, view_top - bottom});
+        }
+    };
+
+    // A "$data" element: one template element expanded once per array item. Rows share a
+    // height measured on the first row and only those near the viewport have widgets.
+    // Rebinding matches rows by "$key" member (or index) and keeps unchanged rows as they are.
+    class Repeater : public wxPanel {
+        struct Row {
+            std::vector<wxWindow *> widgets;
+            TSinks sinks;
+            TResize resize;
+            std::shared_ptr<Arena const> arena;
+        };
+
+        static constexpr size_t overscan {8};
+        static constexpr size_t keep {4 * overscan};
+        static constexpr int border {3};
+
+        TMaterialize materialize_;
+        std::string_view key_;
+        rapidjson::Value const *items_{nullptr};
+        std::shared_ptr<Arena const> arena_;
+        std::vector<size_t> keys_;
+        std::vector<size_t> hashes_;
+        std::vector<std::unique_ptr<Row>> rows_;
+        int row_height_{0};
+        int width_{0};
+        CardViewport *viewport_{nullptr};
+        int listener_{-1};
+
+        size_t KeyOf(rapidjson::Value const &item, size_t index) const {
+            if (!key_.empty() && item.IsObject()) {
+                if (auto const key {resolve(item, key_)}) {
+                    return hash_value(*key);
+                }
+            }
+            return index;
+        }
+
+        void BindRow(Row &row, size_t index) {
+            row.arena = arena_;
+            ResolveSinks(row.sinks, (*items_)[static_cast<rapidjson::SizeType>(index)], arena_);
+        }
+
+        void Place(Row &row, size_t index) {
+            for (auto const widget: row.widgets) {
+                widget->SetSize(0, static_cast<int>(index) * row_height_ + border, width_, row_height_ - 2 * border);
+            }
+        }
+
+        void Release(std::unique_ptr<Row> &row) {
+            for (auto const widget: row->widgets) {
+                widget->Destroy();
+            }
+            row.reset();
+        }
+
+        void Materialize(size_t index) {
+            AC_ALLOC_CARD(CardViewport::AllocCardOf(this));
+            auto row {std::make_unique<Row>()};
+            ExpressionSet const expr{row->sinks};
+            row->resize = materialize_(this, expr, [&row](wxWindow *widget) {
+                row->widgets.push_back(widget);
+            });
+            BindRow(*row, index);
+            if (width_ > 0) {
+                row->resize(width_);
+            }
+            if (row_height_ == 0) {
+                for (auto const widget: row->widgets) {
+                    row_height_ = std::max(row_height_, widget->GetBestSize().GetHeight() + 2 * border);
+                }
+                row_height_ = std::max(row_height_, 1);
+                UpdateSize();
+            }
+            Place(*row, index);
+            rows_[index] = std::move(row);
+        }
+
+        // Callers re-layout the card once they are done rebinding.
+        void UpdateSize() {
+            SetMinSize(wxSize(width_ > 0 ? width_ : wxDefaultCoord, static_cast<int>(rows_.size()) * row_height_));
+        }
+
+        void UpdateVisible() {
+            if (rows_.empty()) {
+                return;
+            }
+            if (!rows_.front() && row_height_ == 0) {
+                Materialize(0);
+            }
+            auto first {size_t{0}};
+            auto last {rows_.size()};
+            if (viewport_) {
+                auto const visible {viewport_->VisiblePart(this)};
+                first = static_cast<size_t>(visible.y / row_height_);
+                last = visible.height > 0 ? std::min(rows_.size(), static_cast<size_t>((visible.y + visible.height) / row_height_ + 1)) : first;
+            }
+            auto const materialize_from {first > overscan ? first - overscan : 0};
+            auto const materialize_to {std::min(rows_.size(), last + overscan)};
+            for (auto index {materialize_from}; index < materialize_to; ++index) {
+                if (!rows_[index]) {
+                    Materialize(index);
+                }
+            }
+            for (size_t index = 0; index < rows_.size(); ++index) {
+                if (rows_[index] && (index + keep < first || index >= last + keep)) {
+                    Release(rows_[index]);
+                }
+            }
+        }
+
+    public:
+        Repeater(wxWindow *parent, TMaterialize materialize, std::string_view key)
+            : wxPanel(parent), materialize_{std::move(materialize)}, key_{binding_path(key).empty() ? key : binding_path(key)},
+              viewport_{CardViewport::Of(parent)} {
+            if (viewport_) {
+                listener_ = viewport_->Listen([this] { UpdateVisible(); });
+            }
+        }
+
+        ~Repeater() override {
+            if (viewport_) {
+                viewport_->Unlisten(listener_);
+            }
+        }
+
+        size_t materialized() const {
+            return static_cast<size_t>(std::count_if(rows_.begin(), rows_.end(), [](auto const &row) { return row != nullptr; }));
+        }
+
+        void SetItems(rapidjson::Value const *items, std::shared_ptr<Arena const> const &arena) {
+            auto const count {items ? static_cast<size_t>(items->Size()) : 0};
+            std::vector<size_t> keys(count);
+            std::vector<size_t> hashes(count);
+            for (size_t index = 0; index < count; ++index) {
+                auto const &item {(*items)[static_cast<rapidjson::SizeType>(index)]};
+                keys[index] = KeyOf(item, index);
+                hashes[index] = hash_value(item);
+            }
+            std::unordered_map<size_t, size_t> previous;
+            for (size_t index = 0; index < rows_.size(); ++index) {
+                if (rows_[index]) {
+                    previous.emplace(keys_[index], index);
+                }
+            }
+            items_ = items;
+            arena_ = arena;
+            std::vector<std::unique_ptr<Row>> rows(count);
+            for (size_t index = 0; index < count; ++index) {
+                auto const pos {previous.find(keys[index])};
+                if (pos == previous.end() || !rows_[pos->second]) {
+                    continue;
+                }
+                rows[index] = std::move(rows_[pos->second]);
+                if (hashes_[pos->second] != hashes[index]) {
+                    BindRow(*rows[index], index);
+                }
+            }
+            for (auto &row: rows_) {
+                if (row) {
+                    Release(row);
+                }
+            }
+            rows_ = std::move(rows);
+            keys_ = std::move(keys);
+            hashes_ = std::move(hashes);
+            for (size_t index = 0; index < rows_.size(); ++index) {
+                if (rows_[index]) {
+                    Place(*rows_[index], index);
+                }
+            }
+            UpdateVisible();
+            UpdateSize();
+        }
+
+        void Resize(int new_size) {
+            width_ = new_size;
+            for (size_t index = 0; index < rows_.size(); ++index) {
+                if (rows_[index]) {
+                    rows_[index]->resize(new_size);
+                    Place(*rows_[index], index);
+                }
+            }
+            UpdateSize();
+        }
+    };
+
+    // Owner-drawn two-column fact list. Only rows inside the update region are drawn, and
+    // each title is measured once when it changes; the title column is the widest of those.
+    class FactSet : public wxWindow {
+    public:
+        struct Fact {
+            std::string title;
+            std::string value;
+
+            bool operator==(Fact const &other) const { return title == other.title && value == other.value; }
+        };
+
+    private:
+        static constexpr int spacing {10};
+
+        std::vector<Fact> facts_;
+        std::vector<int> title_widths_;
+        int title_width_{0};
+        int row_height_{0};
+        wxFont title_font_;
+
+        int MeasureTitle(std::string const &title) {
+            int width {0}, height {0};
+            GetTextExtent(to_wx(title), &width, &height, nullptr, nullptr, &title_font_);
+            return width;
+        }
+
+        wxRect RowRect(size_t index) const {
+            return {0, static_cast<int>(index) * row_height_, GetClientSize().GetWidth(), row_height_};
+        }
+
+        void OnPaint(wxPaintEvent &) {
+            wxPaintDC dc{this};
+            auto const box {GetUpdateRegion().GetBox()};
+            auto const first {static_cast<size_t>(std::max(0, box.y / row_height_))};
+            auto const last {std::min(facts_.size(), static_cast<size_t>(box.GetBottom() / row_height_ + 1))};
+            for (auto index {first}; index < last; ++index) {
+                auto const y {static_cast<int>(index) * row_height_};
+                dc.SetFont(title_font_);
+                dc.DrawText(to_wx(facts_[index].title), 0, y);
+                dc.SetFont(GetFont());
+                dc.DrawText(to_wx(facts_[index].value), title_width_ + spacing, y);
+            }
+        }
+
+    public:
+        explicit FactSet(wxWindow *parent): wxWindow(parent, wxID_ANY), title_font_{GetFont()} {
+            title_font_.SetWeight(wxFONTWEIGHT_BOLD);
+            row_height_ = GetCharHeight() + 4;
+            Bind(wxEVT_PAINT, &FactSet::OnPaint, this);
+        }
+
+        size_t size() const { return facts_.size(); }
+
+        void SetFact(size_t index, Fact fact) {
+            if (index >= facts_.size()) {
+                facts_.resize(index + 1);
+                title_widths_.resize(index + 1);
+            }
+            else if (facts_[index] == fact) {
+                return;
+            }
+            auto const title_changed {facts_[index].title != fact.title || title_widths_[index] == 0};
+            facts_[index] = std::move(fact);
+            if (title_changed) {
+                title_widths_[index] = MeasureTitle(facts_[index].title);
+            }
+            RefreshRect(RowRect(index));
+        }
+
+        // Rebinding: rows whose text is unchanged are not touched or repainted.
+        void SetFacts(std::vector<Fact> &&facts) {
+            auto const previous_rows {facts_.size()};
+            for (size_t index = 0; index < facts.size(); ++index) {
+                SetFact(index, std::move(facts[index]));
+            }
+            facts_.resize(facts.size());
+            title_widths_.resize(facts.size());
+            auto const title_width {title_widths_.empty() ? 0 : *std::max_element(title_widths_.begin(), title_widths_.end())};
+            if (title_width != title_width_) {
+                title_width_ = title_width;
+                Refresh();
+            }
+            if (previous_rows != facts_.size()) {
+                InvalidateBestSize();
+                SetMinSize(wxSize(wxDefaultCoord, static_cast<int>(facts_.size()) * row_height_));
+                Refresh();
+            }
+        }
+
+        // Expands the template "facts" array against `scope`; "$data" entries repeat per item.
+        static std::vector<Fact> Expand(rapidjson::Value const &templates, rapidjson::Value const *scope) {
+            std::vector<Fact> facts;
+            if (!templates.IsArray()) {
+                return facts;
+            }
+            for (auto const &fact: templates.GetArray()) {
+                auto const title {member_view(fact, "title")};
+                auto const value {member_view(fact, "value")};
+                if (!fact.HasMember("$data")) {
+                    facts.push_back({interpolate(title, scope), interpolate(value, scope)});
+                    continue;
+                }
+                auto const items {scope ? resolve(*scope, binding_path(member_view(fact, "$data"))) : nullptr};
+                if (!items || !items->IsArray()) {
+                    continue;
+                }
+                facts.reserve(facts.size() + items->Size());
+                for (auto const &item: items->GetArray()) {
+                    facts.push_back({interpolate(title, &item), interpolate(value, &item)});
+                }
+            }
+            return facts;
+        }
+    };
+
+    // A widget whose value Action.Submit gathers under its "id".
+    class Input {
+    public:
+        virtual ~Input() = default;
+        virtual std::string_view input_id() const = 0;
+        virtual std::string input_value() const = 0;
+    };
+
+    inline void GatherInputs(wxWindow *root, TInputValues &inputs) {
+        for (auto const child: root->GetChildren()) {
+            if (auto const input {dynamic_cast<Input const *>(child)}; input && !input->input_id().empty()) {
+                inputs.emplace_back(input->input_id(), input->input_value());
+            }
+            GatherInputs(child, inputs);
+        }
+    }
+
+    class TextInput : public wxTextCtrl, public Input {
+        std::string_view id_;
+    public:
+        TextInput(wxWindow *parent, std::string_view id, bool multiline)
+            : wxTextCtrl(parent, wxID_ANY, wxEmptyString, wxDefaultPosition, wxDefaultSize, multiline ? wxTE_MULTILINE : 0), id_{id} {}
+
+        std::string_view input_id() const override { return id_; }
+        std::string input_value() const override { return GetValue().utf8_string(); }
+    };
+
+    // Input.ChoiceSet: a search box over an owner-drawn virtual list. Choices are views into
+    // the card's arenas, so bound titles are never copied into a native control. The index is
+    // built on a detached thread that shares the storage it reads, so rebinding just drops a
+    // stale build; a keystroke filters for one frame budget and idle events finish the rest,
+    // growing the list as matches arrive.
+    class ChoiceSet : public wxPanel, public Input {
+        class List : public wxVListBox {
+            ChoiceSet const &owner_;
+            int const row_height_;
+
+        protected:
+            void OnDrawItem(wxDC &dc, wxRect const &rect, size_t n) const override {
+                dc.DrawText(to_wx(owner_.ChoiceAt(n).title), rect.x + 2, rect.y + 2);
+            }
+
+            wxCoord OnMeasureItem(size_t) const override {
+                return row_height_;
+            }
+
+        public:
+            explicit List(ChoiceSet &owner): wxVListBox(&owner, wxID_ANY), owner_{owner}, row_height_{GetCharHeight() + 4} {}
+
+            int row_height() const { return row_height_; }
+        };
+
+        static constexpr auto frame_budget {std::chrono::milliseconds{4}};
+        static constexpr int visible_rows {8};
+
+        std::string_view id_;
+        std::shared_ptr<Arena const> arena_;
+        std::shared_ptr<std::deque<std::string> const> owned_;
+        std::vector<Choice> choices_;
+        // From a packaged_task, so dropping it never waits for the build.
+        std::future<std::unique_ptr<ChoiceIndex>> building_;
+        std::unique_ptr<ChoiceIndex> index_;
+        std::unique_ptr<ChoiceQuery> query_;
+        bool filter_pending_{false};
+        std::string value_;
+        wxTextCtrl *search_;
+        List *list_;
+
+        Choice const &ChoiceAt(size_t n) const {
+            return query_ ? (*index_)[query_->results()[n]] : choices_[n];
+        }
+
+        size_t ShownCount() const {
+            return query_ ? query_->results().size() : choices_.size();
+        }
+
+        // Returns true while filtering still has work left for a later idle event.
+        bool Continue() {
+            if (!index_) {
+                if (!filter_pending_) {
+                    return false;
+                }
+                if (!building_.valid() || building_.wait_for(std::chrono::seconds{0}) != std::future_status::ready) {
+                    return building_.valid();
+                }
+                index_ = building_.get();
+            }
+            if (filter_pending_) {
+                filter_pending_ = false;
+                auto const text {search_->GetValue().utf8_string()};
+                query_ = text.empty() ? nullptr : std::make_unique<ChoiceQuery>(*index_, text, query_.get());
+                list_->SetSelection(wxNOT_FOUND);
+            }
+            else if (!query_ || query_->done()) {
+                return false;
+            }
+            auto const done {!query_ || query_->Step(frame_budget)};
+            list_->SetItemCount(ShownCount());
+            list_->RefreshAll();
+            return !done;
+        }
+
+        void OnIdle(wxIdleEvent &event) {
+            event.Skip();
+            if (Continue()) {
+                event.RequestMore();
+            }
+        }
+
+    public:
+        ChoiceSet(wxWindow *parent, std::string_view id, std::string_view placeholder)
+            : wxPanel(parent), id_{id}, search_{new wxTextCtrl{this, wxID_ANY}}, list_{new List{*this}} {
+            search_->SetHint(to_wx(placeholder));
+            list_->SetMinSize(wxSize(wxDefaultCoord, visible_rows * list_->row_height()));
+            auto const sizer {new wxBoxSizer(wxVERTICAL)};
+            sizer->Add(search_, wxSizerFlags().Expand());
+            sizer->Add(list_, wxSizerFlags().Expand());
+            SetSizer(sizer);
+            search_->Bind(wxEVT_TEXT, [this](wxCommandEvent &) {
+                filter_pending_ = true;
+                Continue();
+            });
+            list_->Bind(wxEVT_LISTBOX, [this](wxCommandEvent &) {
+                auto const selection {list_->GetSelection()};
+                if (selection != wxNOT_FOUND) {
+                    value_ = std::string{ChoiceAt(static_cast<size_t>(selection)).value};
+                }
+            });
+            Bind(wxEVT_IDLE, &ChoiceSet::OnIdle, this);
+        }
+
+        std::string_view input_id() const override { return id_; }
+        std::string input_value() const override { return value_; }
+        void SetValue(std::string_view value) { value_ = std::string{value}; }
+
+        // Replaces the choice list; `owned` holds titles and values that had to be interpolated.
+        void SetChoices(std::vector<Choice> &&choices, std::deque<std::string> &&owned, std::shared_ptr<Arena const> const &arena) {
+            index_.reset();
+            query_.reset();
+            arena_ = arena;
+            owned_ = std::make_shared<std::deque<std::string> const>(std::move(owned));
+            choices_ = std::move(choices);
+            std::packaged_task<std::unique_ptr<ChoiceIndex>()> build {[arena = arena_, owned = owned_, choices = choices_] {
+                return std::make_unique<ChoiceIndex>(choices);
+            }};
+            building_ = build.get_future();
+            std::thread{std::move(build)}.detach();
+            filter_pending_ = !search_->GetValue().empty();
+            list_->SetSelection(wxNOT_FOUND);
+            list_->SetItemCount(choices_.size());
+            list_->RefreshAll();
+        }
+
+        // Expands the template "choices" array against `scope`; "$data" entries repeat per item.
+        // A title or value that is a plain "${path}" to a string is a view into the data arena.
+        static void Expand(rapidjson::Value const &templates, rapidjson::Value const *scope,
+                std::vector<Choice> &choices, std::deque<std::string> &owned) {
+            if (!templates.IsArray()) {
+                return;
+            }
+            auto const field = [&owned](std::string_view text, rapidjson::Value const *item) -> std::string_view {
+                auto const path {binding_path(text)};
+                if (!path.empty() && path.find('}') == std::string_view::npos && item) {
+                    if (auto const value {resolve(*item, path)}; value && value->IsString()) {
+                        return view(*value);
+                    }
+                }
+                if (text.find("${") == std::string_view::npos) {
+                    return text;
+                }
+                return owned.emplace_back(interpolate(text, item));
+            };
+            for (auto const &choice: templates.GetArray()) {
+                auto const title {member_view(choice, "title")};
+                auto const value {member_view(choice, "value", title)};
+                if (!choice.HasMember("$data")) {
+                    choices.push_back({field(title, scope), field(value, scope)});
+                    continue;
+                }
+                auto const items {scope ? resolve(*scope, binding_path(member_view(choice, "$data"))) : nullptr};
+                if (!items || !items->IsArray()) {
+                    continue;
+                }
+                choices.reserve(choices.size() + items->Size());
+                for (auto const &item: items->GetArray()) {
+                    choices.push_back({field(title, &item), field(value, &item)});
+                }
+            }
+        }
+    };
+
+    // A template whose widgets are built on first Build(). Card data is kept as it arrives
+    // and applied once there are widgets to bind.
+    class LazyPanel : public wxPanel {
+        TMaterialize materialize_;
+        TSinks sinks_;
+        TResize resize_;
+        rapidjson::Value const *scope_{nullptr};
+        std::shared_ptr<Arena const> arena_;
+        int width_{0};
+        bool built_{false};
+
+    protected:
+        void Relayout() {
+            if (auto const viewport {CardViewport::Of(this)}) {
+                viewport->Layout();
+                viewport->FitInside();
+                viewport->Changed();
+            }
+        }
+
+    public:
+        LazyPanel(wxWindow *parent, TMaterialize materialize): wxPanel(parent), materialize_{std::move(materialize)} {}
+
+        bool built() const { return built_; }
+
+        void Build() {
+            if (built_) {
+                return;
+            }
+            AC_ALLOC_CARD(CardViewport::AllocCardOf(this));
+            built_ = true;
+            auto const sizer {new wxBoxSizer(wxVERTICAL)};
+            resize_ = materialize_(this, ExpressionSet{sinks_}, [sizer](wxWindow *widget) {
+                sizer->Add(widget, wxSizerFlags().Top().Expand().Border(wxALL, 3));
+            });
+            SetSizer(sizer);
+            if (scope_) {
+                ResolveSinks(sinks_, *scope_, arena_);
+            }
+            if (width_ > 0) {
+                resize_(width_);
+            }
+        }
+
+        void Resize(int new_size) {
+            width_ = new_size;
+            if (built_) {
+                resize_(new_size);
+            }
+        }
+
+        void SetScope(rapidjson::Value const *scope, std::shared_ptr<Arena const> const &arena) {
+            scope_ = scope;
+            arena_ = arena;
+            if (built_ && scope_) {
+                ResolveSinks(sinks_, *scope_, arena_);
+            }
+        }
+    };
+
+    // The body of an Action.ShowCard. Its widgets are built on first expansion, or earlier
+    // from an idle event when prebuild() is on, and stay alive while collapsed.
+    class SubCard : public LazyPanel {
+    public:
+        SubCard(wxWindow *parent, TMaterialize materialize): LazyPanel(parent, std::move(materialize)) {
+            Hide();
+        }
+
+        static bool &prebuild() {
+            static bool enabled {true};
+            return enabled;
+        }
+
+        // Only one body of an action row is expanded at a time.
+        void Toggle() {
+            if (IsShown()) {
+                Hide();
+            }
+            else {
+                Build();
+                for (auto const sibling: GetParent()->GetChildren()) {
+                    if (sibling != this && dynamic_cast<SubCard *>(sibling)) {
+                        sibling->Hide();
+                    }
+                }
+                Show();
+            }
+            Relayout();
+        }
+    };
+
+    // wxImage keeps colour and alpha in separate malloc'd planes, which it takes over.
+    inline wxImage ToWxImage(RgbaImage const &rgba) {
+        auto const pixels {size_t(rgba.width) * rgba.height};
+        auto const rgb {static_cast<unsigned char *>(std::malloc(pixels * 3))};
+        auto const alpha {static_cast<unsigned char *>(std::malloc(pixels))};
+        auto in {rgba.pixels.data()};
+        for (size_t i = 0; i < pixels; ++i, in += 4) {
+            rgb[i * 3 + 0] = in[0];
+            rgb[i * 3 + 1] = in[1];
+            rgb[i * 3 + 2] = in[2];
+            alpha[i] = in[3];
+        }
+        return wxImage{rgba.width, rgba.height, rgb, alpha};
+    }
+
+    // Decoded images by URL, width in pixels, content scale and shape, so elements showing the same
+    // picture decode it once. Entries keep their pixels too, so when a window moves to a
+    // monitor with a lower scale a larger entry is shrunk instead of decoded again.
+    // Used from the UI thread only.
+    class BitmapCache {
+        struct Entry {
+            std::string url;
+            int width;
+            double scale;
+            bool circular;
+            wxBitmap bitmap;
+            DecodePool::TImage pixels;
+        };
+
+        std::list<Entry> entries_;
+        size_t capacity_;
+
+    public:
+        explicit BitmapCache(size_t capacity): capacity_{capacity} {}
+
+        static BitmapCache &instance() {
+            static BitmapCache cache {128};
+            return cache;
+        }
+
+        wxBitmap const *Find(std::string_view url, int width, double scale, bool circular) {
+            auto const pos {std::find_if(entries_.begin(), entries_.end(), [url, width, scale, circular](Entry const &entry) {
+                return entry.width == width && entry.scale == scale && entry.circular == circular && entry.url == url;
+            })};
+            if (pos == entries_.end()) {
+                return nullptr;
+            }
+            entries_.splice(entries_.begin(), entries_, pos);
+            return &entries_.front().bitmap;
+        }
+
+        // The narrowest pixels of `url` wider than `width`, at any scale.
+        DecodePool::TImage FindLarger(std::string_view url, int width, bool circular) const {
+            DecodePool::TImage larger;
+            for (auto const &entry: entries_) {
+                if (entry.pixels && entry.width > width && entry.circular == circular && entry.url == url && (!larger || entry.width < larger->width)) {
+                    larger = entry.pixels;
+                }
+            }
+            return larger;
+        }
+
+        void Insert(std::string_view url, int width, double scale, bool circular, wxBitmap const &bitmap,
+                DecodePool::TImage pixels = nullptr) {
+            entries_.push_front({std::string{url}, width, scale, circular, bitmap, std::move(pixels)});
+            if (entries_.size() > capacity_) {
+                entries_.pop_back();
+            }
+        }
+    };
+
+    // One animated GIF at one size, shared by every element showing it: frames are decoded
+    // once, when first due, and all copies stay in step because the frame shown follows the
+    // time since the animation started. Decoded frames are kept while the budget they are
+    // drawn from allows; past it they are decoded again each time round. UI thread only.
+    class Animation {
+    public:
+        using TClock = CardViewport::TClock;
+
+        // Bytes of frame bitmaps kept by all animations together.
+        struct Budget {
+            size_t used{0};
+            size_t limit;
+        };
+
+    private:
+        FetchPool::TBytes bytes_;
+        GifDecoder gif_;
+        int width_;
+        double scale_;
+        bool circular_;
+        Budget &budget_;
+        TClock::time_point start_{TClock::now()};
+        TClock::duration duration_{};
+        std::vector<wxBitmap> frames_;
+        size_t kept_{0};
+        wxBitmap last_;
+
+        // Which frame is due at `now`, and when the one after it is.
+        std::pair<size_t, TClock::time_point> Due(TClock::time_point now) const {
+            auto const elapsed {now - start_};
+            auto const loops {elapsed / duration_};
+            if (gif_.loops() > 0 && loops > gif_.loops()) {
+                return {gif_.size() - 1, TClock::time_point::max()};
+            }
+            auto at {start_ + loops * duration_};
+            for (size_t frame = 0; frame < gif_.size(); ++frame) {
+                at += gif_.delay(frame);
+                if (now < at) {
+                    return {frame, at};
+                }
+            }
+            return {gif_.size() - 1, at};
+        }
+
+    public:
+        Animation(FetchPool::TBytes bytes, int width, double scale, bool circular, Budget &budget)
+            : bytes_{std::move(bytes)}, gif_{*bytes_}, width_{width}, scale_{scale}, circular_{circular}, budget_{budget},
+              frames_(gif_.size()) {
+            for (size_t frame = 0; frame < gif_.size(); ++frame) {
+                duration_ += gif_.delay(frame);
+            }
+        }
+        Animation(Animation const &) = delete;
+        Animation &operator=(Animation const &) = delete;
+
+        ~Animation() {
+            budget_.used -= kept_;
+        }
+
+        bool animated() const { return gif_.animated(); }
+
+        size_t FrameAt(TClock::time_point now) const {
+            return Due(now).first;
+        }
+
+        TClock::time_point NextChange(TClock::time_point now) const {
+            return Due(now).second;
+        }
+
+        wxBitmap const &Bitmap(size_t frame) {
+            if (frame < frames_.size() && frames_[frame].IsOk()) {
+                return frames_[frame];
+            }
+            auto const canvas {gif_.Frame(frame)};
+            if (!canvas) {
+                return last_;
+            }
+            AC_TRACE_SCOPE(ImageDecode, "gif");
+            auto scaled {Resample(*canvas, width_, std::max(1, int(int64_t(canvas->height) * width_ / canvas->width)))};
+            if (circular_) {
+                ApplyCircle(scaled);
+            }
+            last_ = wxBitmap{ToWxImage(scaled), wxBITMAP_SCREEN_DEPTH, scale_};
+            if (budget_.used + scaled.bytes() <= budget_.limit) {
+                budget_.used += scaled.bytes();
+                kept_ += scaled.bytes();
+                frames_[frame] = last_;
+            }
+            return last_;
+        }
+    };
+
+    // Live animations by URL, width in pixels, content scale and shape. Only the elements
+    // showing an animation keep it alive.
+    class AnimationCache {
+        struct Entry {
+            std::string url;
+            int width;
+            double scale;
+            bool circular;
+            std::weak_ptr<Animation> animation;
+        };
+
+        std::vector<Entry> entries_;
+        Animation::Budget budget_;
+
+    public:
+        explicit AnimationCache(size_t budget): budget_{0, budget} {}
+
+        static AnimationCache &instance() {
+            static AnimationCache cache {32 << 20};
+            return cache;
+        }
+
+        // The animation of `bytes`, shared with other elements showing it at this size; null
+        // when they are not an animated GIF.
+        std::shared_ptr<Animation> Find(std::string_view url, FetchPool::TBytes const &bytes, int width, double scale, bool circular) {
+            entries_.erase(std::remove_if(entries_.begin(), entries_.end(), [](Entry const &entry) {
+                return entry.animation.expired();
+            }), entries_.end());
+            for (auto const &entry: entries_) {
+                if (entry.width == width && entry.scale == scale && entry.circular == circular && entry.url == url) {
+                    return entry.animation.lock();
+                }
+            }
+            if (SniffFormat(*bytes) != ImageFormat::Gif) {
+                return nullptr;
+            }
+            auto animation {std::make_shared<Animation>(bytes, width, scale, circular, budget_)};
+            if (!animation->animated()) {
+                return nullptr;
+            }
+            entries_.push_back({std::string{url}, width, scale, circular, animation});
+            return animation;
+        }
+    };
+
+    // An Image element. Its fetch is ranked by where it is: on screen first, then by distance
+    // from the viewport, and parked past progressive().image_lookahead viewports. Scrolling
+    // re-ranks it; scrolling far enough away parks it again, cancelling a transfer in flight.
+    // Fetched bytes are decoded on DecodePool workers in the same order, at the window's
+    // content scale; moving to another monitor reloads it at the new scale. Person style
+    // images are cut to a circle on the worker as well. Animated GIFs play on the viewport's
+    // animation timer while on screen.
+    class CardImage : public wxStaticBitmap {
+        CardViewport *viewport_{nullptr};
+        int listener_{-1};
+        FetchPool::TTicket ticket_{0};
+        DecodePool::TTicket decoding_{0};
+        std::string_view url_;
+        bool circular_{false};
+        std::shared_ptr<Animation> animation_;
+        int animating_{-1};
+        size_t frame_{0};
+
+        int FetchPriority() const {
+            if (!viewport_ || !viewport_->IsShown()) {
+                return FetchPool::parked;
+            }
+            auto const distance {viewport_->Distance(const_cast<CardImage *>(this))};
+            if (distance > viewport_->GetClientSize().GetHeight() * progressive().image_lookahead) {
+                return FetchPool::parked;
+            }
+            return distance;
+        }
+
+        void Reprioritize() {
+            if (ticket_) {
+                viewport_->Reprioritize(ticket_, FetchPriority());
+            }
+        }
+
+        // Bitmaps are made at the window's content scale factor, so they stay sharp on HiDPI.
+        int PixelWidth() const {
+            return std::max(1, int(std::lround(GetSize().GetWidth() * GetContentScaleFactor())));
+        }
+
+        CardViewport::TDecoded Shown(FetchPool::TBytes bytes, int width, double scale) {
+            return [this, bytes, width, scale](DecodePool::TImage const &decoded) {
+                decoding_ = 0;
+                viewport_->queue().Defer(RenderPriority::Image, [image = wxWeakRef<CardImage>{this}, bytes, decoded, width, scale] {
+                    if (image) {
+                        image->Show(bytes, decoded, width, scale);
+                    }
+                });
+            };
+        }
+
+        // False when `bytes` are not an animated GIF.
+        bool Animate(FetchPool::TBytes const &bytes) {
+            animation_ = AnimationCache::instance().Find(url_, bytes, PixelWidth(), GetContentScaleFactor(), circular_);
+            if (!animation_) {
+                return false;
+            }
+            frame_ = SIZE_MAX;
+            animating_ = viewport_->Animate([this](CardViewport::TClock::time_point now) {
+                if (!IsShownOnScreen() || viewport_->VisiblePart(this).IsEmpty()) {
+                    return CardViewport::TClock::time_point::max();
+                }
+                if (auto const frame {animation_->FrameAt(now)}; frame != frame_) {
+                    frame_ = frame;
+                    SetBitmap(animation_->Bitmap(frame));
+                }
+                return animation_->NextChange(now);
+            });
+            return true;
+        }
+
+        void Fetched(FetchPool::TBytes const &bytes) {
+            ticket_ = 0;
+            if (!bytes || Animate(bytes)) {
+                return;
+            }
+            auto const width {PixelWidth()};
+            auto const scale {GetContentScaleFactor()};
+            if (auto const decoded {BitmapCache::instance().Find(url_, width, scale, circular_)}) {
+                SetBitmap(*decoded);
+                return;
+            }
+            decoding_ = viewport_->Decode(url_, bytes, width, circular_, FetchPriority(), Shown(bytes, width, scale));
+        }
+
+        void Cancel() {
+            if (ticket_) {
+                viewport_->CancelFetch(ticket_);
+                ticket_ = 0;
+            }
+            if (decoding_) {
+                viewport_->CancelDecode(decoding_);
+                decoding_ = 0;
+            }
+            if (animating_ >= 0) {
+                viewport_->StopAnimating(animating_);
+                animating_ = -1;
+            }
+            animation_.reset();
+        }
+
+        // A bitmap at the current scale from the cache, else one shrunk from a larger cached
+        // decode, else from the bytes.
+        void Load() {
+            auto const width {PixelWidth()};
+            auto const scale {GetContentScaleFactor()};
+            if (auto const decoded {BitmapCache::instance().Find(url_, width, scale, circular_)}) {
+                SetBitmap(*decoded);
+                return;
+            }
+            auto const progressive_load {viewport_ && progressive().enabled};
+            if (auto const larger {BitmapCache::instance().FindLarger(url_, width, circular_)}) {
+                if (progressive_load) {
+                    decoding_ = viewport_->Shrink(url_, larger, width, circular_, FetchPriority(), Shown(nullptr, width, scale));
+                }
+                else {
+                    auto const height {std::max(1, int(int64_t(larger->height) * width / larger->width))};
+                    Show(nullptr, std::make_shared<RgbaImage const>(Resample(*larger, width, height)), width, scale);
+                }
+                return;
+            }
+            if (IsLocalSource(url_)) {
+                auto const bytes {LocalSourceBytes(url_)};
+                if (bytes && progressive_load) {
+                    Fetched(bytes);
+                }
+                else if (bytes) {
+                    Decode(bytes);
+                }
+                return;
+            }
+            if (!progressive_load) {
+                if (auto const bytes {FetchPool::instance().FetchNow(url_)}) {
+                    Decode(bytes);
+                }
+                return;
+            }
+            if (auto const cached {ResourceCache::instance().Find(url_)}) {
+                Fetched(cached);
+                return;
+            }
+            ticket_ = viewport_->Fetch(url_, FetchPriority(), [this](FetchPool::TBytes const &bytes) { Fetched(bytes); });
+        }
+
+        void OnDpiChanged(wxDPIChangedEvent &event) {
+            event.Skip();
+            if (!url_.empty()) {
+                Cancel();
+                Load();
+            }
+        }
+
+    public:
+        explicit CardImage(wxWindow *parent)
+            : wxStaticBitmap(parent, wxID_ANY, wxBitmap{1, 1}),
+              viewport_{CardViewport::Of(parent)} {
+            if (viewport_) {
+                listener_ = viewport_->Listen([this] { Reprioritize(); });
+            }
+            Bind(wxEVT_DPI_CHANGED, &CardImage::OnDpiChanged, this);
+        }
+
+        ~CardImage() override {
+            if (viewport_) {
+                Cancel();
+                viewport_->Unlisten(listener_);
+            }
+        }
+
+        // Person style; set before the URL.
+        void SetCircular(bool circular) {
+            circular_ = circular;
+        }
+
+        void SetUrl(std::string_view url) {
+            Cancel();
+            url_ = url;
+            if (!url.empty()) {
+                Load();
+            }
+        }
+
+        // Decodes and scales on the calling thread.
+        void Decode(FetchPool::TBytes const &bytes) {
+            if (viewport_ && Animate(bytes)) {
+                return;
+            }
+            auto const width {PixelWidth()};
+            DecodePool::TImage decoded;
+            {
+                AC_TRACE_SCOPE(ImageDecode, "scaled");
+                auto scaled {DecodeScaled(*bytes, width)};
+                if (circular_ && !scaled.empty()) {
+                    ApplyCircle(scaled);
+                }
+                if (!scaled.empty()) {
+                    decoded = std::make_shared<RgbaImage const>(std::move(scaled));
+                }
+            }
+            Show(bytes, decoded, width, GetContentScaleFactor());
+        }
+
+        // JPEG, PNG and GIF arrive `decoded` at `width` already; other formats go through wxImage
+        // at full size. A result for a scale the window has since left is only cached.
+        void Show(FetchPool::TBytes const &bytes, DecodePool::TImage const &decoded, int width, double scale) {
+            wxImage image;
+            if (decoded) {
+                image = ToWxImage(*decoded);
+            }
+            else if (bytes) {
+                wxMemoryInputStream input_stream{bytes->data(), bytes->size()};
+                {
+                    AC_TRACE_SCOPE(ImageDecode, "wxImage");
+                    image.LoadFile(input_stream);
+                }
+                if (image.Ok()) {
+                    AC_TRACE_SCOPE(ImageRescale, "Rescale");
+                    image.Rescale(width, width * image.GetHeight() / image.GetWidth(), wxIMAGE_QUALITY_HIGH);
+                }
+                if (image.Ok() && circular_) {
+                    if (!image.HasAlpha()) {
+                        image.InitAlpha();
+                    }
+                    auto const mask {MaskCache::instance().Circle(image.GetWidth(), image.GetHeight())};
+                    auto const alpha {image.GetAlpha()};
+                    for (size_t i = 0; i < mask->size(); ++i) {
+                        alpha[i] = uint8_t(detail::div255(uint32_t(alpha[i]) * (*mask)[i]));
+                    }
+                }
+            }
+            if (image.Ok()) {
+                wxBitmap const bitmap {image, wxBITMAP_SCREEN_DEPTH, scale};
+                BitmapCache::instance().Insert(url_, width, scale, circular_, bitmap, decoded);
+                if (width == PixelWidth() && scale == GetContentScaleFactor()) {
+                    SetBitmap(bitmap);
+                }
+            }
+        }
+    };
+
+    // An ImageSet: a grid of thumbnails drawn by this one window from atlas bitmaps, instead
+    // of a wxStaticBitmap per image. Each thumbnail is fetched ranked by its own distance
+    // from the viewport, decoded on DecodePool workers and copied into its cell when it
+    // arrives. The atlas is cut into bands of atlas_columns cells, each with its own bitmap,
+    // and a paint converts only the bands it draws that changed since, so a thumbnail costs
+    // one band's conversion rather than the whole gallery's.
+    class ImageSet : public wxWindow {
+        static constexpr int gap {4};
+        static constexpr int atlas_columns {16};
+
+        struct Thumb {
+            std::string url;
+            FetchPool::TTicket ticket{0};
+            DecodePool::TTicket decoding{0};
+            bool loaded{false};
+        };
+
+        struct Band {
+            RgbaImage pixels;
+            wxBitmap bitmap;
+            bool stale{false};
+        };
+
+        CardViewport *viewport_{nullptr};
+        int listener_{-1};
+        int size_;
+        int columns_{1};
+        double scale_{1};
+        std::vector<Thumb> thumbs_;
+        std::vector<Band> bands_;
+
+        int Pixels() const {
+            return std::max(1, int(std::lround(size_ * scale_)));
+        }
+
+        wxRect CellRect(size_t index) const {
+            auto const column {int(index % size_t(columns_))};
+            auto const row {int(index / size_t(columns_))};
+            return {column * (size_ + gap), row * (size_ + gap), size_, size_};
+        }
+
+        int FetchPriority(size_t index) const {
+            if (!viewport_ || !viewport_->IsShown()) {
+                return FetchPool::parked;
+            }
+            auto const distance {viewport_->Distance(const_cast<ImageSet *>(this), CellRect(index))};
+            if (distance > viewport_->GetClientSize().GetHeight() * progressive().image_lookahead) {
+                return FetchPool::parked;
+            }
+            return distance;
+        }
+
+        void Reprioritize() {
+            for (size_t index = 0; index < thumbs_.size(); ++index) {
+                if (thumbs_[index].ticket) {
+                    viewport_->Reprioritize(thumbs_[index].ticket, FetchPriority(index));
+                }
+            }
+        }
+
+        void Cancel() {
+            for (auto &thumb: thumbs_) {
+                if (thumb.ticket) {
+                    viewport_->CancelFetch(thumb.ticket);
+                }
+                if (thumb.decoding) {
+                    viewport_->CancelDecode(thumb.decoding);
+                }
+            }
+        }
+
+        // Fills the cell, centred; taller images lose their top and bottom.
+        void Place(size_t index, RgbaImage const &image) {
+            auto const pixels {Pixels()};
+            if (image.width != pixels) {
+                return;
+            }
+            auto const rows {std::min(image.height, pixels)};
+            auto const skip {(image.height - rows) / 2};
+            auto &band {bands_[index / atlas_columns]};
+            auto const x {int(index % atlas_columns) * pixels};
+            auto const y {(pixels - rows) / 2};
+            for (int row = 0; row < rows; ++row) {
+                std::copy_n(image.row(skip + row), size_t(pixels) * 4, band.pixels.row(y + row) + size_t(x) * 4);
+            }
+            thumbs_[index].loaded = true;
+            band.stale = true;
+            RefreshRect(CellRect(index));
+        }
+
+        void Fetched(size_t index, FetchPool::TBytes const &bytes) {
+            auto &thumb {thumbs_[index]};
+            thumb.ticket = 0;
+            if (!bytes) {
+                return;
+            }
+            if (!viewport_ || !progressive().enabled) {
+                AC_TRACE_SCOPE(ImageDecode, "scaled");
+                Place(index, DecodeScaled(*bytes, Pixels()));
+                return;
+            }
+            thumb.decoding = viewport_->Decode(thumb.url, bytes, Pixels(), false, FetchPriority(index),
+                [this, index](DecodePool::TImage const &decoded) {
+                    thumbs_[index].decoding = 0;
+                    if (decoded) {
+                        Place(index, *decoded);
+                    }
+                });
+        }
+
+        void Load(size_t index) {
+            auto const &url {thumbs_[index].url};
+            if (IsLocalSource(url)) {
+                Fetched(index, LocalSourceBytes(url));
+            }
+            else if (auto const cached {ResourceCache::instance().Find(url)}) {
+                Fetched(index, cached);
+            }
+            else if (!viewport_ || !progressive().enabled) {
+                Fetched(index, FetchPool::instance().FetchNow(url));
+            }
+            else {
+                thumbs_[index].ticket = viewport_->Fetch(url, FetchPriority(index), [this, index](FetchPool::TBytes const &bytes) {
+                    Fetched(index, bytes);
+                });
+            }
+        }
+
+        void Reload() {
+            Cancel();
+            auto const count {thumbs_.size()};
+            auto const pixels {Pixels()};
+            auto const columns {int(std::min(count, size_t(atlas_columns)))};
+            bands_.clear();
+            bands_.resize((count + atlas_columns - 1) / atlas_columns);
+            for (auto &band: bands_) {
+                band.pixels = RgbaImage{columns * pixels, pixels};
+            }
+            for (size_t index = 0; index < count; ++index) {
+                thumbs_[index].ticket = 0;
+                thumbs_[index].decoding = 0;
+                thumbs_[index].loaded = false;
+                Load(index);
+            }
+            Refresh();
+        }
+
+        void OnPaint(wxPaintEvent &) {
+            wxPaintDC dc{this};
+            dc.SetPen(*wxTRANSPARENT_PEN);
+            dc.SetBrush(wxBrush{wxSystemSettings::GetColour(wxSYS_COLOUR_BTNFACE)});
+            auto const box {GetUpdateRegion().GetBox()};
+            wxMemoryDC atlas;
+            Band const *selected {nullptr};
+            for (size_t index = 0; index < thumbs_.size(); ++index) {
+                auto const cell {CellRect(index)};
+                if (!cell.Intersects(box)) {
+                    continue;
+                }
+                auto &band {bands_[index / atlas_columns]};
+                if (thumbs_[index].loaded && band.stale) {
+                    band.bitmap = wxBitmap{ToWxImage(band.pixels), wxBITMAP_SCREEN_DEPTH, scale_};
+                    band.stale = false;
+                }
+                if (thumbs_[index].loaded && band.bitmap.IsOk()) {
+                    if (selected != &band) {
+                        atlas.SelectObjectAsSource(band.bitmap);
+                        selected = &band;
+                    }
+                    dc.Blit(cell.GetPosition(), cell.GetSize(), &atlas, wxPoint{int(index % atlas_columns) * size_, 0});
+                }
+                else {
+                    dc.DrawRectangle(cell);
+                }
+            }
+        }
+
+        void OnDpiChanged(wxDPIChangedEvent &event) {
+            event.Skip();
+            scale_ = GetContentScaleFactor();
+            Reload();
+        }
+
+    public:
+        // Thumbnail edge for an "imageSize", from the default host config.
+        static int SizeOf(std::string_view image_size) {
+            if (image_size == "Small") {
+                return 40;
+            }
+            if (image_size == "Large") {
+                return 160;
+            }
+            return 80;
+        }
+
+        ImageSet(wxWindow *parent, int size)
+            : wxWindow(parent, wxID_ANY),
+              viewport_{CardViewport::Of(parent)},
+              size_{size},
+              scale_{GetContentScaleFactor()} {
+            SetBackgroundStyle(wxBG_STYLE_PAINT);
+            if (viewport_) {
+                listener_ = viewport_->Listen([this] { Reprioritize(); });
+            }
+            Bind(wxEVT_PAINT, &ImageSet::OnPaint, this);
+            Bind(wxEVT_DPI_CHANGED, &ImageSet::OnDpiChanged, this);
+        }
+
+        ~ImageSet() override {
+            if (viewport_) {
+                Cancel();
+                viewport_->Unlisten(listener_);
+            }
+        }
+
+        size_t size() const { return thumbs_.size(); }
+
+        void SetUrls(std::vector<std::string> &&urls) {
+            if (urls.size() == thumbs_.size() && std::equal(urls.begin(), urls.end(), thumbs_.begin(),
+                    [](std::string const &url, Thumb const &thumb) { return url == thumb.url; })) {
+                return;
+            }
+            Cancel();
+            thumbs_.clear();
+            for (auto &url: urls) {
+                thumbs_.push_back({std::move(url)});
+            }
+            Resize(GetClientSize().GetWidth());
+            Reload();
+        }
+
+        void Resize(int new_size) {
+            columns_ = std::max(1, (new_size + gap) / (size_ + gap));
+            auto const rows {int((thumbs_.size() + columns_ - 1) / columns_)};
+            InvalidateBestSize();
+            SetMinSize(wxSize(wxDefaultCoord, std::max(0, rows * (size_ + gap) - gap)));
+            Refresh();
+            Reprioritize();
+        }
+
+        // The template "images" array against `scope`; "$data" entries repeat per item.
+        static std::vector<std::string> Expand(rapidjson::Value const &templates, rapidjson::Value const *scope) {
+            std::vector<std::string> urls;
+            if (!templates.IsArray()) {
+                return urls;
+            }
+            for (auto const &image: templates.GetArray()) {
+                if (!image.IsObject()) {
+                    continue;
+                }
+                auto const url {member_view(image, "url")};
+                if (image.HasMember("$data")) {
+                    auto const items {scope ? resolve(*scope, binding_path(member_view(image, "$data"))) : nullptr};
+                    if (items && items->IsArray()) {
+                        for (auto const &item: items->GetArray()) {
+                            urls.push_back(interpolate(url, &item));
+                        }
+                    }
+                }
+                else {
+                    urls.push_back(interpolate(url, scope));
+                }
+            }
+            return urls;
+        }
+    };
+}
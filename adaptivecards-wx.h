@@ -1,22 +1,35 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <utility>
 #include <functional>
 #include <vector>
-#include <regex>
-#include <sstream>
+#include <map>
+#include <mutex>
 #include <stack>
+#include <thread>
+#include <chrono>
 #include <wx/wx.h>
 #include <wx/wrapsizer.h>
 #include <wx/fs_inet.h>
 #include <wx/mstream.h>
 #include <wx/image.h> 
+#include <wx/wupdlock.h>
+#include <wx/eventfilter.h>
 #include <memory>
+#include "adaptivecards-core.h"
+#include "adaptivecards-trace.h"
+#include "adaptivecards-widgets.h"
+#include "adaptivecards-submit.h"
+#include "adaptivecards-history.h"
+#include "adaptivecards-prefetch.h"
 #include "rapidjson/rapidjson.h"
 #include "rapidjson/document.h"
 #include <curl/curl.h>
 
 #include <iostream>
+#include <fstream>
+#include <cstdlib>
 
 namespace AdaptiveCards
 {
@@ -30,44 +43,210 @@ namespace AdaptiveCards
         }
     };
 
+    // One set of connections, DNS entries and TLS sessions for every transfer, so the fetch
+    // workers reuse a connection to a host as transfers on one multi handle would.
+    class CurlShare {
+        CURLSH *share_;
+        std::mutex locks_[CURL_LOCK_DATA_LAST];
+
+        static void lock(CURL *, curl_lock_data data, curl_lock_access, void *pthis) {
+            static_cast<CurlShare *>(pthis)->locks_[data].lock();
+        }
+
+        static void unlock(CURL *, curl_lock_data data, void *pthis) {
+            static_cast<CurlShare *>(pthis)->locks_[data].unlock();
+        }
+
+    public:
+        CurlShare(): share_{curl_share_init()} {
+            curl_share_setopt(share_, CURLSHOPT_LOCKFUNC, &CurlShare::lock);
+            curl_share_setopt(share_, CURLSHOPT_UNLOCKFUNC, &CurlShare::unlock);
+            curl_share_setopt(share_, CURLSHOPT_USERDATA, this);
+            for (auto const data: {CURL_LOCK_DATA_CONNECT, CURL_LOCK_DATA_DNS, CURL_LOCK_DATA_SSL_SESSION}) {
+                curl_share_setopt(share_, CURLSHOPT_SHARE, data);
+            }
+        }
+        CurlShare(CurlShare const &) = delete;
+        CurlShare &operator=(CurlShare const &) = delete;
+
+        ~CurlShare() {
+            curl_share_cleanup(share_);
+        }
+
+        static CURLSH *handle() {
+            static CurlShare share;
+            return share.share_;
+        }
+    };
+
+    // One transfer under fetch_limits(): dropped when it stalls, runs out of time or grows
+    // past the body limit, and paced by the shared bandwidth budget. Only complete
+    // bodies are kept; each outcome is counted in TransferMetrics.
     class url_stream {
-        std::stringstream ss_;
+        std::string buffer_;
+        FetchPool::TCancelled cancelled_;
+        bool too_large_{false};
+        std::chrono::microseconds throttled_{0};
         static CurlInit curl_init_;
 
+        bool cancelled() const {
+            return cancelled_ && cancelled_();
+        }
+
+        // Returning less than was received aborts the transfer. Waiting here stops reading
+        // from the socket, so the sender slows down as well.
         static size_t write_data(void *ptr, size_t size, size_t nmemb, url_stream *pthis)
         {
             auto const total{size * nmemb};
-            pthis->ss_.write(static_cast<const char *>(ptr), total);
+            if (pthis->buffer_.size() + total > fetch_limits().max_body_bytes) {
+                pthis->too_large_ = true;
+                return 0;
+            }
+            pthis->buffer_.append(static_cast<const char *>(ptr), total);
+            for (auto wait {Bandwidth::instance().Take(total)}; wait.count() > 0 && !pthis->cancelled();) {
+                auto const step {std::min(wait, std::chrono::microseconds{50000})};
+                std::this_thread::sleep_for(step);
+                pthis->throttled_ += step;
+                wait -= step;
+            }
             return total;
         }
+
+        // A non-zero return aborts the transfer.
+        static int progress(void *pthis, curl_off_t, curl_off_t, curl_off_t, curl_off_t)
+        {
+            return static_cast<url_stream *>(pthis)->cancelled() ? 1 : 0;
+        }
+
+        TransferOutcome Outcome(CURLcode result) const {
+            if (result == CURLE_OK) {
+                return TransferOutcome::Completed;
+            }
+            if (too_large_ || result == CURLE_FILESIZE_EXCEEDED) {
+                return TransferOutcome::TooLarge;
+            }
+            if (result == CURLE_OPERATION_TIMEDOUT) {
+                return TransferOutcome::TimedOut;
+            }
+            return result == CURLE_ABORTED_BY_CALLBACK ? TransferOutcome::Cancelled : TransferOutcome::Failed;
+        }
     public:
-        url_stream(std::string const &url) {
+        url_stream(std::string_view url, FetchPool::TCancelled cancelled = {}): cancelled_{std::move(cancelled)} {
+            std::string const url_z {url};
+            auto const &limits {fetch_limits()};
             auto curl_handle = curl_easy_init();
-            curl_easy_setopt(curl_handle, CURLOPT_URL, url.c_str());
-            curl_easy_setopt(curl_handle, CURLOPT_VERBOSE, 1L);
-            curl_easy_setopt(curl_handle, CURLOPT_NOPROGRESS, 1L);
+            curl_easy_setopt(curl_handle, CURLOPT_URL, url_z.c_str());
+            curl_easy_setopt(curl_handle, CURLOPT_SHARE, CurlShare::handle());
+            // Timeouts without SIGALRM, which is not safe on worker threads.
+            curl_easy_setopt(curl_handle, CURLOPT_NOSIGNAL, 1L);
+            curl_easy_setopt(curl_handle, CURLOPT_FAILONERROR, 1L);
+            curl_easy_setopt(curl_handle, CURLOPT_CONNECTTIMEOUT_MS, long(limits.connect_timeout.count()));
+            curl_easy_setopt(curl_handle, CURLOPT_TIMEOUT_MS, long(limits.timeout.count()));
+            curl_easy_setopt(curl_handle, CURLOPT_LOW_SPEED_LIMIT, limits.stall_bytes);
+            curl_easy_setopt(curl_handle, CURLOPT_LOW_SPEED_TIME, long(limits.stall_time.count()));
+            curl_easy_setopt(curl_handle, CURLOPT_MAXFILESIZE_LARGE, curl_off_t(limits.max_body_bytes));
+            if (cancelled_) {
+                curl_easy_setopt(curl_handle, CURLOPT_NOPROGRESS, 0L);
+                curl_easy_setopt(curl_handle, CURLOPT_XFERINFOFUNCTION, &url_stream::progress);
+                curl_easy_setopt(curl_handle, CURLOPT_XFERINFODATA, this);
+            }
+            else {
+                curl_easy_setopt(curl_handle, CURLOPT_NOPROGRESS, 1L);
+            }
             curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, &url_stream::write_data);
             curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, this);
-            curl_easy_perform(curl_handle);
+            CURLcode result;
+            {
+                AC_TRACE_SCOPE(ImageFetch, "curl");
+                result = curl_easy_perform(curl_handle);
+            }
+            curl_off_t connect_us {0};
+            curl_off_t total_us {0};
+            curl_easy_getinfo(curl_handle, CURLINFO_CONNECT_TIME_T, &connect_us);
+            curl_easy_getinfo(curl_handle, CURLINFO_TOTAL_TIME_T, &total_us);
+            TransferMetrics::instance().Record(Outcome(result), buffer_.size(), uint64_t(connect_us), uint64_t(total_us),
+                uint64_t(throttled_.count()));
+            if (result != CURLE_OK) {
+                buffer_.clear();
+            }
             curl_easy_cleanup(curl_handle);
         }
         wxMemoryInputStream input_stream() {
-            ss_.flush();
-            return wxMemoryInputStream(ss_.str().data(), ss_.str().size());
+            return wxMemoryInputStream(buffer_.data(), buffer_.size());
+        }
+        std::string release() {
+            return std::move(buffer_);
+        }
+    };
+
+#ifdef ADAPTIVECARDS_RENDER_STATS
+    // Paints and sizer layouts since the last ShowCard started. Counting filters every event
+    // in the process, so it is only built for measuring: `make RENDER_STATS=1`, and bench/widgets.
+    struct RenderStats {
+        size_t paints{0};
+        size_t layouts{0};
+    };
+
+    inline RenderStats &render_stats() {
+        static RenderStats stats;
+        return stats;
+    }
+
+    class PaintCounter : public wxEventFilter {
+    public:
+        int FilterEvent(wxEvent &event) override {
+            if (event.GetEventType() == wxEVT_PAINT) {
+                ++render_stats().paints;
+            }
+            return Event_Skip;
         }
     };
 
+    class CardSizer : public wxBoxSizer {
+    public:
+        using wxBoxSizer::wxBoxSizer;
+        void RepositionChildren(const wxSize &min_size) override {
+            ++render_stats().layouts;
+            wxBoxSizer::RepositionChildren(min_size);
+        }
+    };
+#else
+    using CardSizer = wxBoxSizer;
+#endif
+
     class Frame : public wxFrame
     {
     public:
+        using TNavigate = std::function<void(std::string const &locator)>;
+
         Frame(const wxString &title, const wxPoint &pos, const wxSize &size)
             : wxFrame(NULL, wxID_ANY, title, pos, size)
         {
+            auto const go {new wxMenu};
+            go->Append(wxID_BACKWARD, "&Back\tAlt+Left");
+            go->Append(wxID_FORWARD, "&Forward\tAlt+Right");
+            auto const menu_bar {new wxMenuBar};
+            menu_bar->Append(go, "&Go");
+            SetMenuBar(menu_bar);
             CreateStatusBar();
             SetStatusText("Welcome to AdaptiveCards-wxWidgets!");
         }
 
+        void SetNavigate(TNavigate navigate) {
+            navigate_ = std::move(navigate);
+        }
+
+        // Runs after the current event, since navigating may destroy the widget that asked.
+        void Navigate(std::string locator) {
+            if (navigate_) {
+                CallAfter([this, locator = std::move(locator)] { navigate_(locator); });
+            }
+        }
+
     private:
+        TNavigate navigate_;
+
+
         void OnExit(wxCommandEvent &event)
         {
             Close(true);
@@ -75,107 +254,214 @@ namespace AdaptiveCards
         wxDECLARE_EVENT_TABLE();
     };
 
+    // TCardProvider is called from the UI thread and from the prefetch workers at the same
+    // time, so it must be thread-safe; a slow call on one thread never holds up another.
     template <typename TCardProvider, const char * const initial_card>
     class App : public wxApp
     {
+        using THistory = History<CardViewport *>;
+
+        // Built cards kept hidden for back/forward, and what they may cost in total.
+        static constexpr size_t live_cards {5};
+        static constexpr size_t live_card_bytes {32 << 20};
+        // Rough native plus wrapper cost of one widget, for the history budget.
+        static constexpr size_t widget_bytes {2048};
+
+        // Worker threads loading the cards the current one links to, and what they may hold.
+        static constexpr size_t prefetch_concurrency {2};
+        static constexpr size_t prefetch_bytes {8 << 20};
+        static constexpr size_t prefetch_images {16};
+
         TCardProvider cardprovider_;
+        Prefetcher prefetcher_{prefetch_concurrency, prefetch_bytes, [this](std::string const &locator, Prefetcher::TCancelled const &cancelled) {
+            return Prefetch(locator, cancelled);
+        }};
+        std::vector<std::string> next_locators_;
         std::string current_card_;
+        CardViewport *card_panel_{nullptr};
+        THistory history_{live_cards, live_card_bytes};
+#ifdef ADAPTIVECARDS_RENDER_STATS
+        PaintCounter paint_counter_;
+#endif
+        std::map<std::string, ProgressStats> progress_stats_;
+#ifdef ADAPTIVECARDS_ALLOC_TRACKING
+        std::map<std::string, AllocCounters const *> alloc_cards_;
+#endif
     public:
         bool OnInit() override
         {
+            if (!parser_simd_supported()) {
+                std::cerr << "built for " << parser_simd() << " JSON scanning, which this CPU lacks" << std::endl;
+                return false;
+            }
             wxInitAllImageHandlers();
+            if (auto const enabled {std::getenv("ADAPTIVECARDS_PROGRESSIVE")}) {
+                progressive().enabled = std::string_view{enabled} != "0";
+            }
+            if (auto const slice {std::getenv("ADAPTIVECARDS_PROGRESSIVE_SLICE_US")}) {
+                progressive().slice = std::chrono::microseconds{std::atol(slice)};
+            }
+            if (auto const eager {std::getenv("ADAPTIVECARDS_PROGRESSIVE_EAGER")}) {
+                progressive().eager_elements = std::strtoul(eager, nullptr, 10);
+            }
+            if (auto const timeout {std::getenv("ADAPTIVECARDS_FETCH_TIMEOUT_MS")}) {
+                fetch_limits().timeout = std::chrono::milliseconds{std::atol(timeout)};
+            }
+            if (auto const connect_timeout {std::getenv("ADAPTIVECARDS_FETCH_CONNECT_TIMEOUT_MS")}) {
+                fetch_limits().connect_timeout = std::chrono::milliseconds{std::atol(connect_timeout)};
+            }
+            if (auto const max_bytes {std::getenv("ADAPTIVECARDS_FETCH_MAX_BYTES")}) {
+                fetch_limits().max_body_bytes = std::strtoul(max_bytes, nullptr, 10);
+            }
+            if (auto const bandwidth {std::getenv("ADAPTIVECARDS_FETCH_BYTES_PER_SECOND")}) {
+                fetch_limits().bytes_per_second = std::strtoul(bandwidth, nullptr, 10);
+            }
+            if (auto const concurrency {std::getenv("ADAPTIVECARDS_FETCH_CONCURRENCY")}) {
+                fetch_limits().concurrency = std::strtoul(concurrency, nullptr, 10);
+            }
+            if (auto const validate {std::getenv("ADAPTIVECARDS_VALIDATE")}) {
+                schema_config().enabled = std::string_view{validate} != "0";
+            }
+            if (auto const schema {std::getenv("ADAPTIVECARDS_SCHEMA_FILE")}) {
+                schema_config().path = schema;
+            }
+#ifdef ADAPTIVECARDS_RENDER_STATS
+            wxEvtHandler::AddFilter(&paint_counter_);
+#endif
+            FetchPool::instance().SetFetch([](std::string const &url, FetchPool::TCancelled const &cancelled) {
+                if (IsLocalSource(url)) {
+                    auto const bytes {LocalSourceBytes(url)};
+                    return bytes ? std::string{*bytes} : std::string{};
+                }
+                return url_stream{url, cancelled}.release();
+            });
+            FetchPool::instance().SetNotify([] { wxWakeUpIdle(); });
+            DecodePool::instance().SetNotify([] { wxWakeUpIdle(); });
+            SubmitQueue::instance().SetSink([](std::string_view action, std::string_view payload) {
+                std::clog << "submit " << action << ": " << payload << std::endl;
+            });
 
             auto frame = new Frame("Hello World", wxPoint(50, 50), wxSize(450, 340));
+            frame->Bind(wxEVT_MENU, [this, frame](wxCommandEvent &) { Back(frame); }, wxID_BACKWARD);
+            frame->Bind(wxEVT_MENU, [this, frame](wxCommandEvent &) { Forward(frame); }, wxID_FORWARD);
+            frame->Bind(wxEVT_UPDATE_UI, [this](wxUpdateUIEvent &event) { event.Enable(history_.can_back()); }, wxID_BACKWARD);
+            frame->Bind(wxEVT_UPDATE_UI, [this](wxUpdateUIEvent &event) { event.Enable(history_.can_forward()); }, wxID_FORWARD);
+            frame->SetNavigate([this, frame](std::string const &locator) { ShowCard(locator, "{}", frame); });
+            frame->Bind(wxEVT_IDLE, [this](wxIdleEvent &event) {
+                event.Skip();
+                if (!next_locators_.empty()) {
+                    prefetcher_.Request(next_locators_);
+                    next_locators_.clear();
+                }
+            });
             frame->Show(true);
             ShowCard(initial_card, "{}", frame);
             return true;
         }
 
-        using TSinks = std::vector<std::pair<std::string,std::function<void(std::string)>>>;
-        using TSetter = std::function<void(std::string const &)>;
-        using TExpressionSet = std::function<void(TSetter, std::string const &value)>;
-        using TResize = std::function<void(int)>;
-        using TAddWidget = std::function<void(wxWindow *)>;
+        int OnExit() override
+        {
+#ifdef ADAPTIVECARDS_RENDER_STATS
+            wxEvtHandler::RemoveFilter(&paint_counter_);
+#endif
+            prefetcher_.Shutdown();
+            FetchPool::instance().Shutdown();
+            DecodePool::instance().Shutdown();
+            SubmitQueue::instance().Shutdown();
+            if (auto const submit_file {std::getenv("ADAPTIVECARDS_SUBMIT_STATS_FILE")}) {
+                std::ofstream out{submit_file};
+                SubmitQueue::instance().WriteStats(out);
+            }
+            if (auto const fetch_file {std::getenv("ADAPTIVECARDS_FETCH_STATS_FILE")}) {
+                std::ofstream out{fetch_file};
+                TransferMetrics::instance().WriteStats(out);
+            }
+            if (auto const render_file {std::getenv("ADAPTIVECARDS_RENDER_STATS_FILE")}) {
+                std::ofstream out{render_file};
+                WriteProgressStats(out, progress_stats_);
+            }
+#ifdef ADAPTIVECARDS_TRACE
+            if (auto const trace_file {std::getenv("ADAPTIVECARDS_TRACE_FILE")}) {
+                std::ofstream out{trace_file};
+                TraceBuffer::instance().WriteChromeTrace(out);
+            }
+#endif
+#ifdef ADAPTIVECARDS_ALLOC_TRACKING
+            if (auto const alloc_file {std::getenv("ADAPTIVECARDS_ALLOC_FILE")}) {
+                std::ofstream out{alloc_file};
+                WriteAllocReports(out, alloc_reports());
+            }
+#endif
+            return wxApp::OnExit();
+        }
+
+        using TExpressionSet = ExpressionSet;
         using TWidgetFactory = std::function<TResize(rapidjson::Value &, wxWindow *parent, TExpressionSet, TAddWidget)>;
 
-        auto CreateCardTemplate(std::string const &src, Frame *frame) {
-            static const std::map<std::string,TWidgetFactory> widget_factories {
+        template <typename TFactoryPos, typename... TArgs>
+        static TResize CallFactory(TFactoryPos pos, TArgs &&...args) {
+            AC_TRACE_SCOPE(WidgetFactory, pos->first.c_str());
+            return pos->second(std::forward<TArgs>(args)...);
+        }
+
+        static auto const &WidgetFactories() {
+            static const std::map<std::string,TWidgetFactory,std::less<>> widget_factories {
                 {"TextBlock", [](rapidjson::Value &element, wxWindow *frame, TExpressionSet expr, TAddWidget add) {
-                    auto const text {element.HasMember("text") ? std::string(element["text"].GetString()) : std::string()};
-                    auto const label {new wxStaticText(frame, -1, text.c_str())};
+                    auto const text {member_view(element, "text")};
+                    auto const label {new wxStaticText(frame, -1, to_wx(text))};
                     if (element.HasMember("size")) {
                         expr([label](auto size_value) {
                             auto font {label->GetFont()};
-                            if (std::string("Medium") == size_value) {
+                            if (size_value == "Medium") {
                                 font.SetPointSize(font.GetPointSize() * 3 / 2);
                             }
                             label->SetFont(font);
-                        }, element["size"].GetString());
+                        }, member_view(element, "size"));
                     }
                     if (element.HasMember("weight")) {
                         expr([label](auto weight_value){
                             auto font {label->GetFont()};
-                            if (std::string("Bolder") == weight_value) {
+                            if (weight_value == "Bolder") {
                                 font.SetWeight(wxFONTWEIGHT_BOLD);
                             }
                             label->SetFont(font);
-                        }, element["weight"].GetString());
+                        }, member_view(element, "weight"));
                     }
                     add(label);
-                    auto original_text {std::make_shared<std::string>(text)};
+                    auto original_text {std::make_shared<std::string_view>(text)};
                     expr([label, original_text](auto text_value) {
                         *original_text = text_value;
-                        label->SetLabelText(text_value);
+                        label->SetLabelText(to_wx(text_value));
                     }, text);
                     return [label, original_text](int new_size) {
-                        label->SetLabelText(*original_text);
+                        label->SetLabelText(to_wx(*original_text));
                         label->Wrap(new_size);
                     };
                 }},
                 {"ColumnSet", [](rapidjson::Value &element, wxWindow *frame, TExpressionSet expr, TAddWidget add) {
                     auto container{new wxPanel{frame}};
-                    auto sizer {new wxBoxSizer(wxHORIZONTAL)};
-                    TResize resize {[](int ){}};
-                    for (auto &col: element["columns"].GetArray()) {
-                        auto const pos {widget_factories.find(col["type"].GetString())};
-                        if (pos != widget_factories.end()) {
-                            auto added_resize {pos->second(col, container, expr, [sizer](wxWindow *control){
-                                sizer->Add(control);
-                            })};
-                            resize = [resize, added_resize](int new_size){
-                                resize(new_size);
-                                added_resize(new_size);
-                            };
-                        }
-                    }
+                    auto sizer {new CardSizer(wxHORIZONTAL)};
+                    auto resize {AddElements(element, "columns", container, expr, [sizer](wxWindow *control){
+                        sizer->Add(control);
+                    })};
                     container->SetSizer(sizer);
                     add(container);
                     return resize;
                 }},
                 {"Column", [](rapidjson::Value &element, wxWindow *frame, TExpressionSet expr, TAddWidget add) {
                     auto container{new wxPanel{frame}};
-                    auto sizer {new wxBoxSizer(wxVERTICAL)};
-                    TResize resize {[](int ){}};
-                    for (auto &col: element["items"].GetArray()) {
-                        auto const pos {widget_factories.find(col["type"].GetString())};
-                        if (pos != widget_factories.end()) {
-                            auto added_resize {pos->second(col, container, expr, [sizer](wxWindow *control){
-                                sizer->Add(control);
-                            })};
-                            resize = [resize, added_resize](int new_size){
-                                resize(new_size);
-                                added_resize(new_size);
-                            };
-                        }
-                    }
+                    auto sizer {new CardSizer(wxVERTICAL)};
+                    auto resize {AddElements(element, "items", container, expr, [sizer](wxWindow *control){
+                        sizer->Add(control);
+                    })};
                     container->SetSizer(sizer);
                     add(container);
                     return resize;
                 }},
                 {"Image", [](rapidjson::Value &element, wxWindow *frame, TExpressionSet expr, TAddWidget add) {
-                    auto img_control {new wxStaticBitmap{frame, -1, wxBitmap{1,1}}};
-                    auto const size_expr {element.HasMember("size") ? element["size"].GetString() : "Medium"};
-                    expr([img_control](std::string const &value) {
+                    auto img_control {new CardImage{frame}};
+                    auto const size_expr {member_view(element, "size", "Medium")};
+                    expr([img_control](std::string_view value) {
                         if (value == "Small") {
                             img_control->SetSize(wxDefaultCoord, wxDefaultCoord, 75, wxDefaultCoord, wxSIZE_AUTO_HEIGHT);
                         }
@@ -184,89 +470,466 @@ namespace AdaptiveCards
                         }
                         img_control->SetAutoLayout(false);
                     }, size_expr);
-                    expr([img_control](std::string const &value){
-                        auto in {url_stream(value)};
-                        auto input_stream {in.input_stream()};
-                        wxImage image{input_stream};
-                        if(image.Ok())
-                        {
-                            auto const width {img_control->GetSize().GetWidth()};
-                            std::cerr << __LINE__ << " width: " << width << std::endl;
-                            image.Rescale(width, width * image.GetHeight() / image.GetWidth());
-                            wxBitmap bmp{image};
-                            img_control->SetBitmap(bmp);
-                        }
-                    }, element["url"].GetString());
+                    img_control->SetCircular(member_view(element, "style") == "Person");
+                    expr([img_control](std::string_view value){
+                        img_control->SetUrl(value);
+                    }, member_view(element, "url"));
                     add(img_control);
                     return [](int){};
+                }},
+                {"ImageSet", [](rapidjson::Value &element, wxWindow *frame, TExpressionSet expr, TAddWidget add) {
+                    auto const image_set {new ImageSet{frame, ImageSet::SizeOf(member_view(element, "imageSize", "Medium"))}};
+                    auto const &templates {element.HasMember("images") ? element["images"] : element};
+                    expr.Scope([image_set, &templates](rapidjson::Value const *scope, std::shared_ptr<Arena const> const &) {
+                        image_set->SetUrls(ImageSet::Expand(templates, scope));
+                    });
+                    add(image_set);
+                    return [image_set](int new_size) { image_set->Resize(new_size); };
+                }},
+                {"FactSet", [](rapidjson::Value &element, wxWindow *frame, TExpressionSet expr, TAddWidget add) {
+                    auto const facts {new FactSet{frame}};
+                    auto const &templates {element.HasMember("facts") ? element["facts"] : element};
+                    expr.Scope([facts, &templates](rapidjson::Value const *scope, std::shared_ptr<Arena const> const &) {
+                        facts->SetFacts(FactSet::Expand(templates, scope));
+                    });
+                    add(facts);
+                    return [](int){};
+                }},
+                {"Input.ChoiceSet", [](rapidjson::Value &element, wxWindow *frame, TExpressionSet expr, TAddWidget add) {
+                    auto const choice_set {new ChoiceSet{frame, member_view(element, "id"), member_view(element, "placeholder")}};
+                    expr([choice_set](std::string_view value) {
+                        choice_set->SetValue(value);
+                    }, member_view(element, "value"));
+                    auto const &templates {element.HasMember("choices") ? element["choices"] : element};
+                    expr.Scope([choice_set, &templates](rapidjson::Value const *scope, std::shared_ptr<Arena const> const &arena) {
+                        std::vector<Choice> choices;
+                        std::deque<std::string> owned;
+                        ChoiceSet::Expand(templates, scope, choices, owned);
+                        choice_set->SetChoices(std::move(choices), std::move(owned), arena);
+                    });
+                    add(choice_set);
+                    return [](int){};
+                }},
+                {"Input.Text", [](rapidjson::Value &element, wxWindow *frame, TExpressionSet expr, TAddWidget add) {
+                    auto const multiline {element.HasMember("isMultiline") && element["isMultiline"].IsTrue()};
+                    auto const text {new TextInput{frame, member_view(element, "id"), multiline}};
+                    text->SetHint(to_wx(member_view(element, "placeholder")));
+                    expr([text](std::string_view value) {
+                        text->ChangeValue(to_wx(value));
+                    }, member_view(element, "value"));
+                    add(text);
+                    return [](int){};
                 }}
             };
-            TSinks sinks;
-            rapidjson::Document doc;
-            doc.Parse(src.c_str());
-            auto sizer {new wxBoxSizer(wxVERTICAL)};
-            std::function<void(int)> on_size = [sizer](int){ sizer->Layout(); };
-            for (auto &element: doc["body"].GetArray()) {
-                auto const element_type {element["type"].GetString()};
-                auto const pos {widget_factories.find(element_type)};
-                if (pos != widget_factories.end()) {
-                    auto resize = pos->second(element, frame, [&sinks](TSetter setter, std::string const &text) {
-                        std::smatch match_result;
-                        static std::regex const match_expr {"\\$\\{(.+)\\}"};
-                        if (std::regex_match(text, match_result, match_expr)) {
-                            sinks.push_back(std::make_pair(match_result[1], setter));
-                        }
-                        else {
-                            setter(text);
+            return widget_factories;
+        }
+
+        static auto const &ActionFactories() {
+            static const std::map<std::string,TWidgetFactory,std::less<>> action_factories {
+                {"Action.Submit", [](rapidjson::Value &action, wxWindow *bar, TExpressionSet, TAddWidget add) {
+                    auto const button {new wxButton{bar, wxID_ANY, to_wx(member_view(action, "title", "Submit"))}};
+                    auto const key {member_view(action, "id", member_view(action, "title"))};
+                    auto const data {action.HasMember("data") ? &action["data"] : nullptr};
+                    button->Bind(wxEVT_BUTTON, [button, key, data](wxCommandEvent &) {
+                        TInputValues inputs;
+                        GatherInputs(CardViewport::Of(button), inputs);
+                        SubmitQueue::instance().Submit(key, SerializeSubmit(data, inputs));
+                    });
+                    add(button);
+                    return [](int){};
+                }},
+                {"Action.OpenUrl", [](rapidjson::Value &action, wxWindow *bar, TExpressionSet expr, TAddWidget add) {
+                    auto const button {new wxButton{bar, wxID_ANY, to_wx(member_view(action, "title", "Open"))}};
+                    auto const url {std::make_shared<std::string_view>()};
+                    expr([url](std::string_view value) {
+                        *url = value;
+                    }, member_view(action, "url"));
+                    button->Bind(wxEVT_BUTTON, [button, url](wxCommandEvent &) {
+                        auto const frame {dynamic_cast<Frame *>(wxGetTopLevelParent(button))};
+                        if (frame && !url->empty()) {
+                            frame->Navigate(std::string{*url});
                         }
-                    },
-                    [sizer](auto widget){
-                        sizer->Add(widget, wxSizerFlags().Top().Expand().Border(wxALL, 3));
                     });
-                    on_size = [resize,on_size](int new_size){
-                        resize(new_size);
-                        on_size(new_size);
-                    };
+                    add(button);
+                    return [](int){};
+                }},
+                {"Action.ShowCard", [](rapidjson::Value &action, wxWindow *bar, TExpressionSet expr, TAddWidget add) {
+                    auto const button {new wxButton{bar, wxID_ANY, to_wx(member_view(action, "title", "Show"))}};
+                    auto const card {action.FindMember("card")};
+                    if (card == action.MemberEnd() || !card->value.IsObject()) {
+                        button->Disable();
+                        add(button);
+                        return TResize{[](int){}};
+                    }
+                    auto &body {card->value};
+                    auto const sub_card {new SubCard{bar->GetParent(), [&body](wxWindow *parent, TExpressionSet const &sub_expr, TAddWidget sub_add) {
+                        auto const body_resize {AddElements(body, "body", parent, sub_expr, sub_add)};
+                        auto const actions_resize {AddActions(body, parent, sub_expr, sub_add)};
+                        return TResize{[body_resize, actions_resize](int new_size) {
+                            body_resize(new_size);
+                            actions_resize(new_size);
+                        }};
+                    }}};
+                    bar->GetParent()->GetSizer()->Add(sub_card, wxSizerFlags().Expand());
+                    expr.Scope([sub_card](rapidjson::Value const *scope, std::shared_ptr<Arena const> const &arena) {
+                        sub_card->SetScope(scope, arena);
+                    });
+                    button->Bind(wxEVT_BUTTON, [sub_card](wxCommandEvent &) {
+                        sub_card->Toggle();
+                    });
+                    if (SubCard::prebuild()) {
+                        button->Bind(wxEVT_IDLE, [sub_card](wxIdleEvent &event) {
+                            event.Skip();
+                            sub_card->Build();
+                        });
+                    }
+                    add(button);
+                    return TResize{[sub_card](int new_size) {
+                        sub_card->Resize(new_size);
+                    }};
+                }}
+            };
+            return action_factories;
+        }
+
+        // One row of buttons for element["actions"]; Action.ShowCard bodies go below the row.
+        static TResize AddActions(rapidjson::Value &element, wxWindow *parent, TExpressionSet const &expr, TAddWidget const &add) {
+            TResize resize {[](int ){}};
+            auto const actions {element.FindMember("actions")};
+            if (actions == element.MemberEnd() || !actions->value.IsArray()) {
+                return resize;
+            }
+            auto const container {new wxPanel{parent}};
+            auto const sizer {new CardSizer(wxVERTICAL)};
+            auto const bar {new wxPanel{container}};
+            auto const bar_sizer {new CardSizer(wxHORIZONTAL)};
+            sizer->Add(bar, wxSizerFlags().Expand());
+            container->SetSizer(sizer);
+            for (auto &action: actions->value.GetArray()) {
+                auto const pos {ActionFactories().find(member_view(action, "type"))};
+                if (pos == ActionFactories().end()) {
+                    continue;
+                }
+                auto const added_resize {CallFactory(pos, action, bar, expr, [bar_sizer](wxWindow *button) {
+                    bar_sizer->Add(button, wxSizerFlags().Border(wxALL, 3));
+                })};
+                resize = [resize, added_resize](int new_size){
+                    resize(new_size);
+                    added_resize(new_size);
+                };
+            }
+            bar->SetSizer(bar_sizer);
+            add(container);
+            return resize;
+        }
+
+        static TResize AddRepeater(rapidjson::Value &element, wxWindow *parent, TExpressionSet const &expr, TAddWidget const &add) {
+            auto const pos {WidgetFactories().find(member_view(element, "type"))};
+            if (pos == WidgetFactories().end()) {
+                return [](int){};
+            }
+            auto const repeater {new Repeater{parent, [pos, &element](wxWindow *row_parent, TExpressionSet const &row_expr, TAddWidget row_add) {
+                return CallFactory(pos, element, row_parent, row_expr, row_add);
+            }, member_view(element, "$key")}};
+            expr.Array([repeater](rapidjson::Value const *items, std::shared_ptr<Arena const> const &arena) {
+                repeater->SetItems(items, arena);
+            }, member_view(element, "$data"));
+            add(repeater);
+            return [repeater](int new_size) { repeater->Resize(new_size); };
+        }
+
+        // Instantiates one element, or a repeater for a "$data" element; empty for unknown types.
+        static TResize AddElement(rapidjson::Value &item, wxWindow *parent, TExpressionSet const &expr, TAddWidget const &add) {
+            if (!item.IsObject()) {
+                return nullptr;
+            }
+            if (item.HasMember("$data")) {
+                return AddRepeater(item, parent, expr, add);
+            }
+            auto const pos {WidgetFactories().find(member_view(item, "type"))};
+            if (pos == WidgetFactories().end()) {
+                return nullptr;
+            }
+            return CallFactory(pos, item, parent, expr, add);
+        }
+
+        // Instantiates element[member], expanding "$data" elements into repeaters.
+        static TResize AddElements(rapidjson::Value &element, const char *member, wxWindow *parent, TExpressionSet const &expr, TAddWidget const &add) {
+            TResize resize {[](int ){}};
+            auto const items {element.FindMember(member)};
+            if (items == element.MemberEnd() || !items->value.IsArray()) {
+                return resize;
+            }
+            for (auto &item: items->value.GetArray()) {
+                auto const added_resize {AddElement(item, parent, expr, add)};
+                if (!added_resize) {
+                    continue;
+                }
+                resize = [resize, added_resize](int new_size){
+                    resize(new_size);
+                    added_resize(new_size);
+                };
+            }
+            return resize;
+        }
+
+        // The card body: text and the first progressive().eager_elements elements are built
+        // now; later containers get a placeholder that the viewport's render queue fills in.
+        static TResize AddBody(rapidjson::Value &card, CardViewport *viewport, TExpressionSet const &expr, TAddWidget const &add) {
+            auto const &config {progressive()};
+            auto const items {card.FindMember("body")};
+            if (!config.enabled || items == card.MemberEnd() || !items->value.IsArray()) {
+                return AddElements(card, "body", viewport, expr, add);
+            }
+            TResize resize {[](int ){}};
+            size_t index {0};
+            for (auto &item: items->value.GetArray()) {
+                TResize added_resize;
+                if (index++ < config.eager_elements || member_view(item, "type") == "TextBlock") {
+                    added_resize = AddElement(item, viewport, expr, add);
+                }
+                else if (item.IsObject() && (item.HasMember("$data") || WidgetFactories().count(member_view(item, "type")))) {
+                    auto const placeholder {new LazyPanel{viewport, [&item](wxWindow *parent, TExpressionSet const &item_expr, TAddWidget item_add) {
+                        auto const item_resize {AddElement(item, parent, item_expr, item_add)};
+                        return item_resize ? item_resize : TResize{[](int){}};
+                    }}};
+                    expr.Scope([placeholder](rapidjson::Value const *scope, std::shared_ptr<Arena const> const &arena) {
+                        placeholder->SetScope(scope, arena);
+                    });
+                    viewport->queue().Defer(RenderPriority::Deferred, [placeholder] {
+                        placeholder->Build();
+                    });
+                    add(placeholder);
+                    added_resize = [placeholder](int new_size) { placeholder->Resize(new_size); };
+                }
+                if (!added_resize) {
+                    continue;
                 }
+                resize = [resize, added_resize](int new_size){
+                    resize(new_size);
+                    added_resize(new_size);
+                };
             }
+            return resize;
+        }
+
+        auto CreateCardTemplate(std::shared_ptr<Card> const &card, CardViewport *frame) {
+            TSinks sinks;
+            auto sizer {new CardSizer(wxVERTICAL)};
+            auto const add {[sizer](wxWindow *widget){
+                sizer->Add(widget, wxSizerFlags().Top().Expand().Border(wxALL, 3));
+            }};
+            auto const resize {AddBody(card->doc(), frame, TExpressionSet{sinks}, add)};
+            auto const actions_resize {AddActions(card->doc(), frame, TExpressionSet{sinks}, add)};
+            // Only rewraps; the scroll helper lays the sizer out at the new size once this returns.
+            std::function<void(int)> on_size = [resize, actions_resize](int new_size){
+                resize(new_size);
+                actions_resize(new_size);
+            };
             frame->SetSizer(sizer);
-            frame->Bind( wxEVT_SIZE, [on_size,sizer](wxSizeEvent& event) {
+            frame->Bind( wxEVT_SIZE, [on_size,card,frame](wxSizeEvent& event) {
+                AC_ALLOC_CARD(frame->alloc_card());
+                AC_TRACE_SCOPE(Resize, "wrap");
                 on_size(event.GetSize().GetWidth());
-                event.Skip();
+                frame->Changed();
             } );
             return sinks;
         }
 
-        static auto split(std::string const &src, char delimiter = '.') {
-            std::stringstream ss(src);
-            std::vector<std::string> result;
-            std::string word;
-            while (std::getline(ss, word, delimiter)) {
-                result.push_back(word);
+#ifdef ADAPTIVECARDS_ALLOC_TRACKING
+        // Heap used by each card, keyed by locator: what its thread did while ShowCard built
+        // it, and what its viewport built later from idle events. The latest showing wins.
+        std::map<std::string, AllocReport> alloc_reports() const {
+            std::map<std::string, AllocReport> reports;
+            for (auto const &card: alloc_cards_) {
+                reports.emplace(card.first, card.second->Snapshot());
+            }
+            return reports;
+        }
+#endif
+
+    private:
+        static size_t CountWidgets(wxWindow *window) {
+            size_t count {0};
+            for (auto const child: window->GetChildren()) {
+                count += 1 + CountWidgets(child);
+            }
+            return count;
+        }
+
+        static void ReleasePanel(CardViewport *panel) {
+            panel->Destroy();
+        }
+
+        std::pair<std::string, std::string> Fetch(std::string_view locator, std::string_view data) {
+            AC_TRACE_SCOPE(ProviderFetch, "provider");
+            return cardprovider_(locator, data);
+        }
+
+        // Runs on a prefetch worker: fetch and compile the card, then queue its images to warm
+        // the resource cache behind anything on screen.
+        Prefetched Prefetch(std::string const &locator, Prefetcher::TCancelled const &cancelled) {
+            auto result {Fetch(locator, "{}")};
+            if (cancelled()) {
+                return {};
+            }
+            auto card {std::make_shared<Card>(std::move(result.first))};
+            {
+                AC_TRACE_SCOPE(TemplateParse, "prefetch");
+                card->SetData(std::move(result.second));
+            }
+            std::vector<std::string> urls;
+            CollectImageUrls(card->doc(), &card->data(), urls, prefetch_images);
+            for (auto const &url: urls) {
+                if (cancelled()) {
+                    return {};
+                }
+                if (!IsLocalSource(url) && !ResourceCache::instance().Contains(url)) {
+                    FetchPool::instance().Warm(&prefetcher_, url);
+                }
+            }
+            auto const bytes {card->bytes()};
+            return {std::move(card), bytes};
+        }
+
+        // Prefetching for the card just shown starts at the next idle event.
+        void PrefetchFrom(Card &card) {
+            next_locators_.clear();
+            CollectLocators(card.doc(), &card.data(), next_locators_);
+        }
+
+        CardViewport *BuildCard(std::shared_ptr<Card> const &card, Frame *frame) {
+            auto panel {new CardViewport{frame}};
+            panel->Hide();
+            auto sinks {CreateCardTemplate(card, panel)};
+            ResolveSinks(sinks, card->data(), card->data_arena());
+            return panel;
+        }
+
+        // First paint and completion of `panel`, from when navigation to it began, are kept
+        // per locator for ADAPTIVECARDS_RENDER_STATS_FILE. Completion waits for the images
+        // in and near view to be fetched, decoded and shown.
+        void TimeProgress(CardViewport *panel, std::string locator, RenderQueue::TClock::time_point started) {
+            panel->queue().Start(started, [this, locator = std::move(locator)](ProgressStats const &stats) {
+                progress_stats_[locator] = stats;
+            });
+        }
+
+        void SaveScroll() {
+            if (auto const entry {history_.current()}; entry && entry->view) {
+                int x {0};
+                entry->view->GetViewStart(&x, &entry->scroll);
             }
-            return result;
         }
 
-        void ResolveSinks(TSinks &sinks, std::string const &data) {
-            rapidjson::Document doc;
-            doc.Parse(data.c_str());
-            auto t{0};
-            for (auto &sink: sinks) {
-                std::reference_wrapper<const rapidjson::Value> last_value{doc};
-                for(std::string const &member: split(sink.first)) {
-                    auto o {last_value.get().GetObject()};
-                    last_value = std::cref(o[member.c_str()]);
+        // Shows a history entry, rebuilding evicted ones from their compiled template.
+        void Restore(THistory::Entry &entry, Frame *frame) {
+            auto const started {RenderQueue::TClock::now()};
+#ifdef ADAPTIVECARDS_RENDER_STATS
+            render_stats() = {};
+#endif
+            prefetcher_.Cancel();
+            wxWindowUpdateLocker lock{frame};
+            if (!entry.view) {
+#ifdef ADAPTIVECARDS_ALLOC_TRACKING
+                auto const alloc_card {AllocTracker::instance().NewCard()};
+                alloc_cards_[entry.locator] = alloc_card;
+                AC_ALLOC_CARD(alloc_card);
+#endif
+                auto result {Fetch(entry.locator, entry.posted)};
+                {
+                    AC_TRACE_SCOPE(TemplateParse, "data");
+                    entry.card->SetData(std::move(result.second));
                 }
-                auto const result{last_value.get().GetString()};
-                sink.second(result);
+                entry.view = BuildCard(entry.card, frame);
+                TimeProgress(entry.view, entry.locator, started);
+                entry.bytes = entry.card->bytes() + CountWidgets(entry.view) * widget_bytes;
             }
+            FetchPool::instance().CancelOwner(&prefetcher_);
+            SwapCardPanel(entry.view, frame);
+            entry.view->Scroll(0, entry.scroll);
+            current_card_ = entry.locator;
+            history_.Evict(&ReleasePanel);
+            PrefetchFrom(*entry.card);
         }
 
-        void ShowCard(std::string const &locator, std::string const &data, Frame *frame) {
-            auto const result {cardprovider_(locator, data)};
-            auto sinks {CreateCardTemplate(result.first, frame)};
-            ResolveSinks(sinks, result.second);
+    public:
+        void ShowCard(std::string_view locator, std::string_view data, Frame *frame) {
+            auto const started {RenderQueue::TClock::now()};
+#ifdef ADAPTIVECARDS_RENDER_STATS
+            render_stats() = {};
+#endif
+#ifdef ADAPTIVECARDS_ALLOC_TRACKING
+            auto const alloc_card {AllocTracker::instance().NewCard()};
+            AC_ALLOC_CARD(alloc_card);
+#endif
+            auto card {data == "{}" ? prefetcher_.Take(locator) : nullptr};
+            prefetcher_.Cancel();
+            if (!card) {
+                auto result {Fetch(locator, data)};
+                {
+                    AC_TRACE_SCOPE(TemplateParse, "template");
+                    card = std::make_shared<Card>(std::move(result.first));
+                }
+                AC_TRACE_SCOPE(TemplateParse, "data");
+                card->SetData(std::move(result.second));
+            }
+            if (!card->error().empty()) {
+                std::clog << "card " << locator << ": " << card->error() << std::endl;
+                card = std::make_shared<Card>(ErrorCardTemplate(card->error()));
+                card->SetData("{}");
+            }
+            wxWindowUpdateLocker lock{frame};
+            auto const panel {BuildCard(card, frame)};
+            TimeProgress(panel, std::string{locator}, started);
+            // After BuildCard, so images the new card shares with a warming fetch join it.
+            FetchPool::instance().CancelOwner(&prefetcher_);
+            SaveScroll();
+            SwapCardPanel(panel, frame);
+            auto const bytes {card->bytes() + CountWidgets(panel) * widget_bytes};
+            PrefetchFrom(*card);
+            history_.Push({std::string{locator}, std::string{data}, std::move(card), panel, bytes, 0}, &ReleasePanel);
             current_card_ = locator;
+#ifdef ADAPTIVECARDS_ALLOC_TRACKING
+            alloc_cards_[current_card_] = alloc_card;
+#endif
+        }
+
+        void Back(Frame *frame) {
+            SaveScroll();
+            if (auto const entry {history_.Back()}) {
+                Restore(*entry, frame);
+            }
+        }
+
+        void Forward(Frame *frame) {
+            SaveScroll();
+            if (auto const entry {history_.Forward()}) {
+                Restore(*entry, frame);
+            }
+        }
+
+        THistory const &history() const { return history_; }
+        CardViewport *card_panel() const { return card_panel_; }
+
+        // The previous panel is only hidden; the history decides when it is destroyed. Its
+        // image requests are parked, aborting their transfers, until it is shown again.
+        void SwapCardPanel(CardViewport *panel, Frame *frame) {
+            auto frame_sizer {frame->GetSizer()};
+            if (!frame_sizer) {
+                frame_sizer = new wxBoxSizer(wxVERTICAL);
+                frame->SetSizer(frame_sizer);
+            }
+            if (card_panel_) {
+                frame_sizer->Detach(card_panel_);
+                card_panel_->Hide();
+                card_panel_->Changed();
+            }
+            frame_sizer->Add(panel, wxSizerFlags().Proportion(1).Expand());
+            card_panel_ = panel;
+            panel->Show();
+            frame->Layout();
+            panel->Changed();
         }
     };
 }
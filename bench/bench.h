@@ -0,0 +1,79 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../rapidjson/stringbuffer.h"
+#include "../rapidjson/writer.h"
+
+namespace AdaptiveCards::Bench
+{
+    struct Timing {
+        size_t iterations{0};
+        double mean_us{0};
+        double min_us{0};
+        double max_us{0};
+    };
+
+    // Runs setup() untimed and body() timed for each iteration.
+    template <typename TSetup, typename TBody>
+    Timing measure(size_t iterations, TSetup &&setup, TBody &&body) {
+        Timing timing{iterations, 0, 1e300, 0};
+        for (size_t i = 0; i < iterations; ++i) {
+            setup();
+            auto const start {std::chrono::steady_clock::now()};
+            body();
+            auto const elapsed {std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count()};
+            timing.mean_us += elapsed;
+            timing.min_us = std::min(timing.min_us, elapsed);
+            timing.max_us = std::max(timing.max_us, elapsed);
+        }
+        timing.mean_us /= iterations ? iterations : 1;
+        return timing;
+    }
+
+    template <typename TBody>
+    Timing measure(size_t iterations, TBody &&body) {
+        return measure(iterations, []{}, std::forward<TBody>(body));
+    }
+
+    using TParams = std::vector<std::pair<const char *, double>>;
+
+    // One JSON object per line on stdout, tagged with $BENCH_COMMIT when set.
+    inline void emit(const char *benchmark, TParams const &params, Timing const &timing, TParams const &metrics = {}) {
+        rapidjson::StringBuffer buffer;
+        rapidjson::Writer<rapidjson::StringBuffer> writer{buffer};
+        writer.StartObject();
+        writer.Key("benchmark");
+        writer.String(benchmark);
+        if (auto const commit {std::getenv("BENCH_COMMIT")}) {
+            writer.Key("commit");
+            writer.String(commit);
+        }
+        writer.Key("params");
+        writer.StartObject();
+        for (auto const &param: params) {
+            writer.Key(param.first);
+            writer.Double(param.second);
+        }
+        writer.EndObject();
+        writer.Key("iterations");
+        writer.Uint64(timing.iterations);
+        writer.Key("mean_us");
+        writer.Double(timing.mean_us);
+        writer.Key("min_us");
+        writer.Double(timing.min_us);
+        writer.Key("max_us");
+        writer.Double(timing.max_us);
+        for (auto const &metric: metrics) {
+            writer.Key(metric.first);
+            writer.Double(metric.second);
+        }
+        writer.EndObject();
+        std::printf("%s\n", buffer.GetString());
+        std::fflush(stdout);
+    }
+}
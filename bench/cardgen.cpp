@@ -0,0 +1,36 @@
+// Writes a synthetic card: cardgen [--elements N] [--depth D] [--density P] [--images M]
+//                                  [--rows R] [--pretty 0|1] [--seed S] [--image-url URL]
+//                                  [--out PREFIX]
+// producing PREFIX.template.json and PREFIX.data.json.
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include "cardgen.h"
+
+int main(int argc, char **argv) {
+    AdaptiveCards::Bench::CorpusParams params;
+    std::string out {"card"};
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string const option {argv[i]};
+        std::string const value {argv[i + 1]};
+        if (option == "--elements") params.elements = std::stoul(value);
+        else if (option == "--depth") params.depth = std::stoul(value);
+        else if (option == "--density") params.binding_density = std::stod(value);
+        else if (option == "--images") params.images = std::stoul(value);
+        else if (option == "--rows") params.rows = std::stoul(value);
+        else if (option == "--pretty") params.pretty = value != "0";
+        else if (option == "--seed") params.seed = std::stoul(value);
+        else if (option == "--image-url") params.image_url = value;
+        else if (option == "--out") out = value;
+        else {
+            std::cerr << "unknown option " << option << std::endl;
+            return 1;
+        }
+    }
+    auto const card {AdaptiveCards::Bench::generate_card(params)};
+    std::ofstream{out + ".template.json"} << card.card_template;
+    std::ofstream{out + ".data.json"} << card.data;
+    std::cout << out << ": " << card.card_template.size() << " template bytes, "
+        << card.data.size() << " data bytes, " << card.bindings << " bindings" << std::endl;
+    return 0;
+}
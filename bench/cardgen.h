@@ -0,0 +1,216 @@
+#pragma once
+#include <algorithm>
+#include <random>
+#include <string>
+#include "../rapidjson/prettywriter.h"
+#include "../rapidjson/stringbuffer.h"
+#include "../rapidjson/writer.h"
+
+namespace AdaptiveCards::Bench
+{
+    struct CorpusParams {
+        size_t elements{50};
+        size_t depth{2};
+        double binding_density{0.5};
+        size_t images{5};
+        // Rows of a "$data" array bound by one more body element; 0 for none. Each row is
+        // about 250 bytes, so 4000 rows make a megabyte of data.
+        size_t rows{0};
+        // Indents the data document, as hand-written and many service payloads are.
+        bool pretty{false};
+        unsigned seed{1};
+        std::string image_url{"https://example.invalid/avatar.png"};
+    };
+
+    struct GeneratedCard {
+        std::string card_template;
+        std::string data;
+        size_t bindings{0};
+    };
+
+    // Builds a template whose leaves (TextBlocks and Images) are grouped into ColumnSets
+    // nested `depth` levels deep, plus a data document that satisfies every binding.
+    class CardGenerator {
+        using TWriter = rapidjson::Writer<rapidjson::StringBuffer>;
+
+        CorpusParams const params_;
+        std::mt19937 random_;
+        size_t leaf_{0};
+        size_t images_written_{0};
+        size_t bindings_{0};
+
+        bool NextIsImage() const {
+            if (images_written_ >= params_.images) {
+                return false;
+            }
+            auto const stride {params_.elements / params_.images};
+            return stride == 0 || leaf_ % stride == 0;
+        }
+
+        void WriteLeaf(TWriter &writer) {
+            auto const id {std::to_string(leaf_)};
+            writer.StartObject();
+            if (NextIsImage()) {
+                ++images_written_;
+                ++bindings_;
+                writer.Key("type");
+                writer.String("Image");
+                writer.Key("size");
+                writer.String("Small");
+                writer.Key("url");
+                writer.String(("${images.i" + id + "}").c_str());
+            }
+            else {
+                writer.Key("type");
+                writer.String("TextBlock");
+                writer.Key("wrap");
+                writer.Bool(true);
+                writer.Key("text");
+                if (std::bernoulli_distribution{params_.binding_density}(random_)) {
+                    ++bindings_;
+                    writer.String(("${fields.f" + id + ".text}").c_str());
+                }
+                else {
+                    writer.String(("Literal text for element " + id).c_str());
+                }
+            }
+            writer.EndObject();
+            ++leaf_;
+        }
+
+        void WriteItems(TWriter &writer, size_t count, size_t depth) {
+            if (depth == 0 || count <= 2) {
+                for (size_t i = 0; i < count; ++i) {
+                    WriteLeaf(writer);
+                }
+                return;
+            }
+            writer.StartObject();
+            writer.Key("type");
+            writer.String("ColumnSet");
+            writer.Key("columns");
+            writer.StartArray();
+            for (auto const column_count: {count / 2, count - count / 2}) {
+                writer.StartObject();
+                writer.Key("type");
+                writer.String("Column");
+                writer.Key("items");
+                writer.StartArray();
+                WriteItems(writer, column_count, depth - 1);
+                writer.EndArray();
+                writer.EndObject();
+            }
+            writer.EndArray();
+            writer.EndObject();
+        }
+
+        template <typename TDataWriter>
+        void WriteRows(TDataWriter &writer) const {
+            writer.Key("rows");
+            writer.StartArray();
+            for (size_t i = 0; i < params_.rows; ++i) {
+                auto const id {std::to_string(i)};
+                writer.StartObject();
+                writer.Key("id");
+                writer.Uint64(i);
+                writer.Key("title");
+                writer.String(("Row " + id + " title, long enough to need a few vector steps to scan").c_str());
+                writer.Key("subtitle");
+                writer.String(("Updated by \"someone\" on line " + id + "\twith an escape or two").c_str());
+                writer.Key("score");
+                writer.Double(double(i % 1000) / 7);
+                writer.Key("done");
+                writer.Bool(i % 3 == 0);
+                writer.Key("tags");
+                writer.StartArray();
+                writer.String("alpha");
+                writer.String("beta");
+                writer.EndArray();
+                writer.Key("avatar");
+                writer.String(params_.image_url.c_str());
+                writer.EndObject();
+            }
+            writer.EndArray();
+        }
+
+        template <typename TDataWriter>
+        void WriteData(TDataWriter &writer) const {
+            writer.StartObject();
+            writer.Key("fields");
+            writer.StartObject();
+            for (size_t i = 0; i < params_.elements; ++i) {
+                writer.Key(("f" + std::to_string(i)).c_str());
+                writer.StartObject();
+                writer.Key("text");
+                writer.String(("Bound text value number " + std::to_string(i) + " with enough words to wrap").c_str());
+                writer.EndObject();
+            }
+            writer.EndObject();
+            writer.Key("images");
+            writer.StartObject();
+            for (size_t i = 0; i < params_.elements; ++i) {
+                writer.Key(("i" + std::to_string(i)).c_str());
+                writer.String(params_.image_url.c_str());
+            }
+            writer.EndObject();
+            if (params_.rows > 0) {
+                WriteRows(writer);
+            }
+            writer.EndObject();
+        }
+
+    public:
+        explicit CardGenerator(CorpusParams params): params_{std::move(params)}, random_{params_.seed} {}
+
+        GeneratedCard Generate() {
+            GeneratedCard card;
+            {
+                rapidjson::StringBuffer buffer;
+                TWriter writer{buffer};
+                writer.StartObject();
+                writer.Key("type");
+                writer.String("AdaptiveCard");
+                writer.Key("version");
+                writer.String("1.0");
+                writer.Key("body");
+                writer.StartArray();
+                size_t constexpr group {8};
+                for (size_t written = 0; written < params_.elements; written += group) {
+                    WriteItems(writer, std::min(group, params_.elements - written), params_.depth);
+                }
+                if (params_.rows > 0) {
+                    ++bindings_;
+                    writer.StartObject();
+                    writer.Key("type");
+                    writer.String("TextBlock");
+                    writer.Key("$data");
+                    writer.String("${rows}");
+                    writer.Key("text");
+                    writer.String("${title}");
+                    writer.EndObject();
+                }
+                writer.EndArray();
+                writer.EndObject();
+                card.card_template = buffer.GetString();
+            }
+            {
+                rapidjson::StringBuffer buffer;
+                if (params_.pretty) {
+                    rapidjson::PrettyWriter<rapidjson::StringBuffer> writer{buffer};
+                    WriteData(writer);
+                }
+                else {
+                    TWriter writer{buffer};
+                    WriteData(writer);
+                }
+                card.data = buffer.GetString();
+            }
+            card.bindings = bindings_;
+            return card;
+        }
+    };
+
+    inline GeneratedCard generate_card(CorpusParams const &params) {
+        return CardGenerator{params}.Generate();
+    }
+}
@@ -0,0 +1,110 @@
+// Headless benchmarks for Input.ChoiceSet: index build and per-keystroke filtering.
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "../adaptivecards-choices.h"
+#include "bench.h"
+
+using namespace AdaptiveCards;
+using namespace AdaptiveCards::Bench;
+
+static std::vector<std::string> generate_titles(size_t count) {
+    static const char *const first[] {"Ada", "Grace", "Alan", "Edsger", "Barbara", "Donald", "Frances", "Ken", "Radia", "Niklaus"};
+    static const char *const last[] {"Lovelace", "Hopper", "Turing", "Dijkstra", "Liskov", "Knuth", "Allen", "Thompson", "Perlman", "Wirth"};
+    std::mt19937 random{42};
+    std::vector<std::string> titles;
+    titles.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        titles.push_back(std::string{first[random() % 10]} + " " + last[random() % 10] + " #" + std::to_string(random() % 1000000));
+    }
+    return titles;
+}
+
+// Typing `typed` a character at a time must end where a fresh query for it does.
+static bool incremental_matches_fresh(ChoiceIndex const &index, std::string const &typed) {
+    auto const complete = [](ChoiceQuery &query) {
+        while (!query.Step(std::chrono::hours{1})) {
+        }
+    };
+    std::unique_ptr<ChoiceQuery> query;
+    for (size_t length = 1; length <= typed.size(); ++length) {
+        auto next {std::make_unique<ChoiceQuery>(index, typed.substr(0, length), query.get())};
+        complete(*next);
+        query = std::move(next);
+    }
+    ChoiceQuery fresh{index, typed};
+    complete(fresh);
+    if (query->results() == fresh.results()) {
+        return true;
+    }
+    std::fprintf(stderr, "choice_filter: typing \"%s\" gave %zu results, a fresh query %zu\n",
+        typed.c_str(), query->results().size(), fresh.results().size());
+    return false;
+}
+
+static bool check_incremental() {
+    // "ababx" matches "ab" as a prefix but "abx" only further in.
+    std::vector<Choice> const choices {{"ababx", "1"}, {"zabx", "2"}};
+    return incremental_matches_fresh(ChoiceIndex{choices}, "abx");
+}
+
+static bool run(size_t count) {
+    auto const titles {generate_titles(count)};
+    std::vector<Choice> choices;
+    choices.reserve(count);
+    for (auto const &title: titles) {
+        choices.push_back({title, title});
+    }
+    TParams const config {{"choices", double(count)}};
+
+    auto const build {measure(5, [&]{
+        ChoiceIndex index{choices};
+    })};
+    emit("choice_index_build", config, build);
+
+    ChoiceIndex const index{choices};
+    auto const budget {std::chrono::milliseconds{4}};
+    for (std::string const typed: {"hop", "knuth #12", "a"}) {
+        size_t matches {0};
+        double worst_keystroke_us {0};
+        size_t slices {0};
+        auto const timing {measure(20, [&]{
+            std::unique_ptr<ChoiceQuery> query;
+            for (size_t length = 1; length <= typed.size(); ++length) {
+                auto const start {std::chrono::steady_clock::now()};
+                auto next {std::make_unique<ChoiceQuery>(index, typed.substr(0, length), query.get())};
+                next->Step(budget);
+                worst_keystroke_us = std::max(worst_keystroke_us,
+                    std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+                for (++slices; !next->Step(budget); ++slices) {
+                }
+                query = std::move(next);
+            }
+            matches = query->results().size();
+        })};
+        emit("choice_filter", {{"choices", double(count)}, {"typed", double(typed.size())}}, timing, {
+            {"matches", double(matches)},
+            {"worst_keystroke_us", worst_keystroke_us},
+            {"slices", double(slices / 20)}
+        });
+        if (!incremental_matches_fresh(index, typed)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main() {
+    if (!check_incremental()) {
+        return 1;
+    }
+    for (size_t const count: {1000, 50000, 200000}) {
+        if (!run(count)) {
+            return 1;
+        }
+    }
+    return 0;
+}
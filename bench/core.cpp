@@ -0,0 +1,100 @@
+// Headless benchmarks over the synthetic corpus: template parse, schema validation and
+// binding resolution.
+#include <vector>
+#include "../adaptivecards-core.h"
+#include "bench.h"
+#include "cardgen.h"
+
+using namespace AdaptiveCards;
+using namespace AdaptiveCards::Bench;
+
+static void collect_bindings(rapidjson::Value const &value, std::vector<std::string_view> &paths) {
+    if (value.IsObject()) {
+        for (auto const &member: value.GetObject()) {
+            collect_bindings(member.value, paths);
+        }
+    }
+    else if (value.IsArray()) {
+        for (auto const &item: value.GetArray()) {
+            collect_bindings(item, paths);
+        }
+    }
+    else {
+        auto const path {binding_path(view(value))};
+        if (!path.empty()) {
+            paths.push_back(path);
+        }
+    }
+}
+
+static void run(CorpusParams const &params) {
+    auto const card {generate_card(params)};
+    TParams const config {
+        {"elements", double(params.elements)},
+        {"depth", double(params.depth)},
+        {"binding_density", params.binding_density},
+        {"images", double(params.images)}
+    };
+    size_t const iterations {params.elements >= 1000 ? 50u : 500u};
+
+    std::string source;
+    auto const parse {measure(iterations, [&]{ source = card.card_template; }, [&]{
+        Card parsed{std::move(source)};
+    })};
+    emit("template_parse", config, parse, {{"bytes", double(card.card_template.size())}});
+
+    // Trailing whitespace spelling out the iteration gives every source its own hash, so
+    // each parse misses the verdict cache and runs the validator.
+    size_t round {0};
+    auto const unseen {[&]{
+        source = card.card_template;
+        for (auto bits {++round}; bits; bits >>= 1) {
+            source += bits & 1 ? '\t' : ' ';
+        }
+    }};
+    auto const validate {measure(iterations, unseen, [&]{
+        Card parsed{std::move(source)};
+    })};
+    schema_config().enabled = false;
+    auto const unchecked {measure(iterations, unseen, [&]{
+        Card parsed{std::move(source)};
+    })};
+    schema_config().enabled = true;
+    emit("template_validate", config, validate, {
+        {"bytes", double(card.card_template.size())},
+        {"unchecked_mean_us", unchecked.mean_us},
+        {"cached_mean_us", parse.mean_us}
+    });
+
+    Card parsed{std::string{card.card_template}};
+    std::vector<std::string_view> paths;
+    collect_bindings(parsed.doc(), paths);
+    size_t resolved {0};
+    auto const bind {measure(iterations, [&]{ source = card.data; }, [&]{
+        parsed.SetData(std::move(source));
+        for (auto const path: paths) {
+            resolved += resolve(parsed.data(), path) != nullptr;
+        }
+    })};
+    emit("binding_resolution", config, bind, {
+        {"bindings", double(paths.size())},
+        {"resolved", double(resolved / iterations)},
+        {"bytes", double(card.data.size())}
+    });
+}
+
+int main() {
+    for (size_t const elements: {10, 100, 1000}) {
+        for (size_t const depth: {0, 3}) {
+            for (double const density: {0.1, 0.9}) {
+                CorpusParams params;
+                params.elements = elements;
+                params.depth = depth;
+                params.binding_density = density;
+                params.images = elements / 10;
+                run(params);
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,406 @@
+// Headless benchmarks for image decoding: full decode then resample, against decoding near
+// the target width (JPEG DCT scaling, PNG row reduction) then resampling, on large
+// synthetic sources at the Image sizes "Small" (75) and "Medium" (250). Also the resampler
+// alone per instruction set and filter, a batch of decodes on DecodePool workers against
+// the same batch on one thread, a window moving from a 2x to a 1x monitor, the Person
+// style circle mask, image bytes from "data:" URIs and mapped local files, and a dozen
+// animated GIF avatars playing.
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../adaptivecards-decodepool.h"
+#include "../adaptivecards-source.h"
+#include "bench.h"
+
+using namespace AdaptiveCards;
+using namespace AdaptiveCards::Bench;
+
+// A smooth gradient with some texture, so neither codec gets an unrealistically easy input.
+static RgbaImage synthetic(int width, int height) {
+    RgbaImage image{width, height};
+    uint32_t noise {12345};
+    for (int y = 0; y < height; ++y) {
+        auto out {image.row(y)};
+        for (int x = 0; x < width; ++x, out += 4) {
+            noise = noise * 1103515245 + 12345;
+            out[0] = uint8_t(x * 255 / width);
+            out[1] = uint8_t(y * 255 / height);
+            out[2] = uint8_t(((x ^ y) & 0x3F) + (noise >> 26));
+            out[3] = 0xFF;
+        }
+    }
+    return image;
+}
+
+static std::string encode_jpeg(RgbaImage const &image) {
+    jpeg_compress_struct info;
+    jpeg_error_mgr error;
+    info.err = jpeg_std_error(&error);
+    jpeg_create_compress(&info);
+    unsigned char *buffer {nullptr};
+    unsigned long size {0};
+    jpeg_mem_dest(&info, &buffer, &size);
+    info.image_width = image.width;
+    info.image_height = image.height;
+    info.input_components = 3;
+    info.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&info);
+    jpeg_set_quality(&info, 90, TRUE);
+    jpeg_start_compress(&info, TRUE);
+    std::vector<JSAMPLE> rgb(size_t(image.width) * 3);
+    while (info.next_scanline < info.image_height) {
+        auto const in {image.row(int(info.next_scanline))};
+        for (int x = 0; x < image.width; ++x) {
+            std::copy(in + x * 4, in + x * 4 + 3, rgb.data() + x * 3);
+        }
+        JSAMPROW row {rgb.data()};
+        jpeg_write_scanlines(&info, &row, 1);
+    }
+    jpeg_finish_compress(&info);
+    jpeg_destroy_compress(&info);
+    std::string bytes(reinterpret_cast<char *>(buffer), size);
+    free(buffer);
+    return bytes;
+}
+
+static std::string encode_png(RgbaImage const &image) {
+    png_image info{};
+    info.version = PNG_IMAGE_VERSION;
+    info.width = image.width;
+    info.height = image.height;
+    info.format = PNG_FORMAT_RGBA;
+    png_alloc_size_t size {0};
+    png_image_write_to_memory(&info, nullptr, &size, 0, image.pixels.data(), 0, nullptr);
+    std::string bytes(size, '\0');
+    png_image_write_to_memory(&info, bytes.data(), &size, 0, image.pixels.data(), 0, nullptr);
+    bytes.resize(size);
+    return bytes;
+}
+
+static void decode(char const *format, std::string const &bytes, int target, bool scaled) {
+    DecodeStats stats;
+    RgbaImage result;
+    auto const timing {measure(5, [&]{
+        if (scaled) {
+            result = DecodeScaled(bytes, target, &stats);
+            return;
+        }
+        // The old path: decode everything, then resample the full image.
+        auto const full {SniffFormat(bytes) == ImageFormat::Jpeg ? DecodeJpeg(bytes, 0, &stats) : DecodePng(bytes, 0, &stats)};
+        result = Resample(full, target, full.height * target / full.width);
+        stats.peak_bytes = full.bytes() + ResampleScratchBytes(full, target) + result.bytes();
+    })};
+    emit("image_decode", {
+        {"jpeg", format[0] == 'j' ? 1.0 : 0.0},
+        {"source_width", double(stats.source_width)},
+        {"target_width", double(target)},
+        {"scaled", scaled ? 1.0 : 0.0}
+    }, timing, {
+        {"decoded_width", double(stats.decoded_width)},
+        {"peak_bytes", double(stats.peak_bytes)},
+        {"result_height", double(result.height)}
+    });
+}
+
+static void resample(RgbaImage const &source, int target, ResampleFilter filter, SimdLevel level) {
+    RgbaImage result;
+    auto const timing {measure(5, [&]{
+        result = Resample(source, target, source.height * target / source.width, filter, level);
+    })};
+    emit("image_resample", {
+        {"source_width", double(source.width)},
+        {"target_width", double(target)},
+        {"lanczos", filter == ResampleFilter::Lanczos3 ? 1.0 : 0.0},
+        {"simd", double(level)}
+    }, timing, {
+        {"result_height", double(result.height)}
+    });
+}
+
+// `images` distinct URLs of the same JPEG, as a card full of thumbnails would ask for them.
+static void decode_batch(std::string const &jpeg, size_t images, size_t workers) {
+    DecodePool pool {workers};
+    int const owner {0};
+    size_t round {0};
+    auto const timing {measure(5, [&]{
+        if (workers == 0) {
+            for (size_t i = 0; i < images; ++i) {
+                DecodeScaled(jpeg, 250);
+            }
+            return;
+        }
+        auto const bytes {SharedBytes(std::string{jpeg})};
+        ++round;
+        for (size_t i = 0; i < images; ++i) {
+            pool.Request(&owner, "image" + std::to_string(round) + "-" + std::to_string(i), bytes, 250, int(i));
+        }
+        for (size_t taken {0}; taken < images;) {
+            taken += pool.Take(&owner).size();
+            std::this_thread::yield();
+        }
+    })};
+    emit("image_decode_batch", {
+        {"images", double(images)},
+        {"workers", double(workers)},
+        {"hardware_threads", double(std::thread::hardware_concurrency())}
+    }, timing, {
+        {"decode_us", double(pool.stats().decode_us)}
+    });
+}
+
+// What the window needs at 1x after it was showing the image at 2x: shrink the cached 2x
+// pixels, or decode the source again.
+static void monitor_change(char const *format, std::string const &bytes, int target) {
+    auto const cached {DecodeScaled(bytes, target * 2)};
+    for (bool const shrink: {false, true}) {
+        RgbaImage result;
+        auto const timing {measure(5, [&]{
+            result = shrink ? Resample(cached, target, std::max(1, cached.height * target / cached.width)) : DecodeScaled(bytes, target);
+        })};
+        emit("image_scale_change", {
+            {"jpeg", format[0] == 'j' ? 1.0 : 0.0},
+            {"target_width", double(target)},
+            {"from_cache", shrink ? 1.0 : 0.0}
+        }, timing, {
+            {"result_height", double(result.height)}
+        });
+    }
+}
+
+// A feed's worth of avatars: the mask made for each one, against made once and shared.
+static void circle_mask(int size, SimdLevel level, bool cached) {
+    size_t constexpr avatars {200};
+    RgbaImage avatar{size, size};
+    std::fill(avatar.pixels.begin(), avatar.pixels.end(), uint8_t(0xFF));
+    auto const timing {measure(5, [&]{
+        for (size_t i = 0; i < avatars; ++i) {
+            auto image {avatar};
+            if (cached) {
+                ApplyMask(image, *MaskCache::instance().Circle(size, size), level);
+            }
+            else {
+                ApplyMask(image, CircleMask(size, size), level);
+            }
+        }
+    })};
+    emit("circle_mask", {
+        {"size", double(size)},
+        {"avatars", double(avatars)},
+        {"simd", double(level)},
+        {"cached", cached ? 1.0 : 0.0}
+    }, timing);
+}
+
+static std::string encode_base64(std::string_view bytes) {
+    constexpr char alphabet[] {"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"};
+    std::string text;
+    for (size_t i = 0; i < bytes.size(); i += 3) {
+        uint32_t group {uint32_t(uint8_t(bytes[i])) << 16};
+        if (i + 1 < bytes.size()) {
+            group |= uint32_t(uint8_t(bytes[i + 1])) << 8;
+        }
+        if (i + 2 < bytes.size()) {
+            group |= uint8_t(bytes[i + 2]);
+        }
+        text.push_back(alphabet[group >> 18]);
+        text.push_back(alphabet[(group >> 12) & 0x3F]);
+        text.push_back(i + 1 < bytes.size() ? alphabet[(group >> 6) & 0x3F] : '=');
+        text.push_back(i + 2 < bytes.size() ? alphabet[group & 0x3F] : '=');
+    }
+    return text;
+}
+
+// An inline image: the payload decoded, then the JPEG decoded near the target width.
+static void data_uri(std::string const &jpeg, SimdLevel level) {
+    auto const payload {encode_base64(jpeg)};
+    std::string bytes;
+    double decode_us {0};
+    auto const timing {measure(5, [&]{
+        auto const start {std::chrono::steady_clock::now()};
+        Base64Decode(payload, bytes, level);
+        decode_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        DecodeScaled(bytes, 250);
+    })};
+    emit("image_data_uri", {
+        {"payload_bytes", double(payload.size())},
+        {"simd", double(level)}
+    }, timing, {
+        {"base64_us", decode_us},
+        {"matches", bytes == jpeg ? 1.0 : 0.0}
+    });
+}
+
+// A file:// image: mapped, against read into a string the way a curl transfer buffers it.
+static void local_file(std::string const &jpeg, bool mapped) {
+    auto const path {"/tmp/adaptivecards-bench-" + std::to_string(::getpid()) + ".jpg"};
+    std::ofstream{path, std::ios::binary}.write(jpeg.data(), std::streamsize(jpeg.size()));
+    auto const timing {measure(5, [&]{
+        if (mapped) {
+            auto const bytes {FileUriBytes("file://" + path)};
+            DecodeScaled(*bytes, 250);
+        }
+        else {
+            std::ostringstream buffer;
+            buffer << std::ifstream{path, std::ios::binary}.rdbuf();
+            DecodeScaled(buffer.str(), 250);
+        }
+    })};
+    std::remove(path.c_str());
+    emit("image_local_file", {
+        {"file_bytes", double(jpeg.size())},
+        {"mapped", mapped ? 1.0 : 0.0}
+    }, timing);
+}
+
+// A `frames` frame animated GIF of a moving gradient, 40ms a frame, looping forever. The
+// LZW stream is uncompressed: literal codes only, with a clear code before the table
+// would grow, so the codes stay 9 bits wide.
+static std::string encode_gif(int width, int height, int frames) {
+    std::string gif {"GIF89a"};
+    auto const u16 {[&gif](int value) {
+        gif.push_back(char(value & 0xFF));
+        gif.push_back(char(value >> 8));
+    }};
+    u16(width);
+    u16(height);
+    gif += "\xF7";
+    gif += std::string(2, '\0');
+    for (int i = 0; i < 256; ++i) {
+        gif += {char(i), char(255 - i), char((i * 4) & 0xFF)};
+    }
+    gif += std::string{"\x21\xFF\x0BNETSCAPE2.0\x03\x01\x00\x00\x00", 19};
+    for (int frame = 0; frame < frames; ++frame) {
+        gif += std::string{"\x21\xF9\x04\x00\x04\x00\x00\x00\x2C", 9};
+        u16(0);
+        u16(0);
+        u16(width);
+        u16(height);
+        gif += std::string{"\x00\x08", 2};
+        std::string data;
+        uint32_t bits {0};
+        int count {0};
+        auto const code {[&](uint32_t value) {
+            bits |= value << count;
+            for (count += 9; count >= 8; count -= 8, bits >>= 8) {
+                data.push_back(char(bits & 0xFF));
+            }
+        }};
+        int literals {0};
+        code(256);
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                if (++literals == 254) {
+                    code(256);
+                    literals = 0;
+                }
+                code(uint32_t((x + y + frame * 8) & 0xFF));
+            }
+        }
+        code(257);
+        if (count > 0) {
+            data.push_back(char(bits & 0xFF));
+        }
+        for (size_t at = 0; at < data.size(); at += 255) {
+            auto const length {std::min<size_t>(255, data.size() - at)};
+            gif.push_back(char(length));
+            gif += data.substr(at, length);
+        }
+        gif.push_back('\0');
+    }
+    gif.push_back('\x3B');
+    return gif;
+}
+
+// Two seconds of `avatars` Small GIF avatars playing, ticking at every frame. Shared: one
+// decoder and one set of kept frames for all of them, as CardImage does; otherwise every
+// avatar decodes and scales each frame it shows.
+static void gif_playback(std::string const &gif, size_t avatars, bool shared) {
+    auto const probe {GifDecoder{gif}};
+    auto const frames {probe.size()};
+    auto const ticks {size_t(std::chrono::seconds{2} / probe.delay(0))};
+    size_t decoded {0};
+    auto const timing {measure(5, [&]{
+        std::vector<GifDecoder> decoders(shared ? 1 : avatars, GifDecoder{gif});
+        std::vector<RgbaImage> kept(frames);
+        decoded = 0;
+        for (size_t tick = 0; tick < ticks; ++tick) {
+            auto const frame {tick % frames};
+            for (size_t avatar = 0; avatar < avatars; ++avatar) {
+                if (shared && !kept[frame].empty()) {
+                    continue;
+                }
+                auto const canvas {decoders[shared ? 0 : avatar].Frame(frame)};
+                auto scaled {Resample(*canvas, 75, 75 * canvas->height / canvas->width)};
+                ++decoded;
+                if (shared) {
+                    kept[frame] = std::move(scaled);
+                }
+            }
+        }
+    })};
+    emit("gif_playback", {
+        {"avatars", double(avatars)},
+        {"frames", double(frames)},
+        {"shared", shared ? 1.0 : 0.0}
+    }, timing, {
+        {"frames_decoded", double(decoded)},
+        {"cpu_share", timing.mean_us / 2e6}
+    });
+}
+
+int main() {
+    auto const source {synthetic(4000, 3000)};
+    auto const jpeg {encode_jpeg(source)};
+    auto const png {encode_png(source)};
+    for (int const target: {75, 250}) {
+        for (bool const scaled: {false, true}) {
+            decode("jpeg", jpeg, target, scaled);
+            decode("png", png, target, scaled);
+        }
+    }
+    for (auto const &input: {synthetic(1000, 750), source}) {
+        for (int const target: {75, 250}) {
+            for (auto const filter: {ResampleFilter::Bilinear, ResampleFilter::Lanczos3}) {
+                for (auto const level: {SimdLevel::Scalar, SimdLevel::Sse2, SimdLevel::Avx2}) {
+                    if (level <= simd_level()) {
+                        resample(input, target, filter, level);
+                    }
+                }
+            }
+        }
+    }
+    for (int const target: {75, 250}) {
+        monitor_change("jpeg", jpeg, target);
+        monitor_change("png", png, target);
+    }
+    for (int const size: {32, 75}) {
+        circle_mask(size, SimdLevel::Scalar, false);
+        for (auto const level: {SimdLevel::Scalar, SimdLevel::Sse2, SimdLevel::Avx2}) {
+            if (level <= simd_level()) {
+                circle_mask(size, level, true);
+            }
+        }
+    }
+    auto const photo {encode_jpeg(synthetic(1600, 1200))};
+    for (auto const level: {SimdLevel::Scalar, SimdLevel::Avx2}) {
+        if (level <= simd_level()) {
+            data_uri(photo, level);
+        }
+    }
+    for (bool const mapped: {false, true}) {
+        local_file(photo, mapped);
+    }
+    auto const gif {encode_gif(240, 240, 24)};
+    for (bool const shared: {false, true}) {
+        gif_playback(gif, 12, shared);
+    }
+    for (size_t const workers: {0, 1, 4}) {
+        decode_batch(photo, 16, workers);
+    }
+    return 0;
+}
@@ -0,0 +1,181 @@
+// Headless benchmarks for the image fetch pool: how soon the images in view arrive when a
+// long feed is requested at once, ranked by viewport distance or in document order, what a
+// scroll during the fetch cancels, how many network requests a feed that repeats a few
+// URLs makes, and how closely transfers sharing a bandwidth budget keep to it.
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../adaptivecards-fetch.h"
+#include "bench.h"
+
+using namespace AdaptiveCards;
+using namespace AdaptiveCards::Bench;
+
+constexpr size_t rows {200};
+constexpr size_t visible_rows {10};
+constexpr size_t lookahead_rows {10};
+constexpr std::chrono::microseconds transfer {2000};
+
+static std::atomic<uint64_t> network_requests {0};
+
+static std::string fake_fetch(std::string const &url, FetchPool::TCancelled const &cancelled) {
+    ++network_requests;
+    for (auto waited {std::chrono::microseconds{0}}; waited < transfer; waited += transfer / 4) {
+        if (cancelled()) {
+            return {};
+        }
+        std::this_thread::sleep_for(transfer / 4);
+    }
+    return url;
+}
+
+// Distance in rows from the visible ones, parked past the lookahead.
+static int priority(size_t row, size_t first_visible) {
+    auto const distance {row < first_visible ? first_visible - row
+        : row >= first_visible + visible_rows ? row + 1 - first_visible - visible_rows : 0};
+    return distance > lookahead_rows ? FetchPool::parked : int(distance);
+}
+
+static std::vector<FetchPool::TTicket> request(FetchPool &pool, std::string const &prefix, size_t first_visible, bool ranked) {
+    std::vector<FetchPool::TTicket> tickets;
+    for (size_t row = 0; row < rows; ++row) {
+        auto const url {prefix + std::to_string(row)};
+        tickets.push_back(pool.Request(&pool, url, ranked ? priority(row, first_visible) : 0));
+    }
+    return tickets;
+}
+
+// Collects results until every row from `first` on screen has arrived.
+static size_t wait_visible(FetchPool &pool, std::vector<FetchPool::TTicket> const &tickets, size_t first) {
+    size_t arrived {0};
+    size_t taken {0};
+    while (arrived < visible_rows) {
+        for (auto const &result: pool.Take(&pool)) {
+            ++taken;
+            for (auto row {first}; row < first + visible_rows; ++row) {
+                arrived += tickets[row] == result.ticket;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds{100});
+    }
+    return taken;
+}
+
+static void jump(bool ranked) {
+    static size_t run {0};
+    size_t const first {150};
+    size_t fetched {0};
+    auto const timing {measure(5, [&]{
+        FetchPool pool{4, &fake_fetch};
+        auto const tickets {request(pool, "jump" + std::to_string(run++) + "/", first, ranked)};
+        fetched = wait_visible(pool, tickets, first);
+        pool.CancelOwner(&pool);
+    })};
+    emit("fetch_visible_first", {{"rows", double(rows)}, {"ranked", ranked ? 1.0 : 0.0}}, timing, {
+        {"fetched_before_visible", double(fetched)}
+    });
+}
+
+static void scroll() {
+    static size_t run {0};
+    FetchStats stats;
+    auto const timing {measure(5, [&]{
+        FetchPool pool{4, &fake_fetch};
+        auto const tickets {request(pool, "scroll" + std::to_string(run++) + "/", 0, true)};
+        std::this_thread::sleep_for(transfer);
+        size_t const first {100};
+        for (size_t row = 0; row < rows; ++row) {
+            pool.Reprioritize(tickets[row], priority(row, first));
+        }
+        wait_visible(pool, tickets, first);
+        pool.CancelOwner(&pool);
+        pool.Shutdown();
+        stats = pool.stats();
+    })};
+    emit("fetch_scroll", {{"rows", double(rows)}}, timing, {
+        {"fetched", double(stats.fetched)},
+        {"cancelled", double(stats.cancelled)},
+        {"reprioritized", double(stats.reprioritized)}
+    });
+}
+
+// Every row shows one of `authors` profile images, all requested while on screen.
+static void dedup(size_t authors) {
+    static size_t run {0};
+    uint64_t requests {0};
+    FetchStats stats;
+    auto const timing {measure(5, [&]{
+        auto const prefix {"dedup" + std::to_string(run++) + "/"};
+        FetchPool pool{4, &fake_fetch};
+        auto const before {network_requests.load()};
+        std::vector<FetchPool::TTicket> tickets;
+        for (size_t row = 0; row < rows; ++row) {
+            tickets.push_back(pool.Request(&pool, prefix + std::to_string(row % authors), 0));
+        }
+        size_t delivered {0};
+        while (delivered < rows) {
+            for (auto const &result: pool.Take(&pool)) {
+                delivered += result.bytes != nullptr;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds{100});
+        }
+        pool.Shutdown();
+        requests = network_requests - before;
+        stats = pool.stats();
+    })};
+    emit("fetch_dedup", {{"rows", double(rows)}, {"authors", double(authors)}}, timing, {
+        {"network_requests", double(requests)},
+        {"transfers", double(stats.transfers)},
+        {"joined", double(stats.joined)}
+    });
+}
+
+// `images` transfers of `body` bytes on `workers` threads, received in 16KB reads paced by
+// one budget; the rate they reach together against the one configured.
+static void bandwidth(size_t bytes_per_second, size_t workers) {
+    constexpr size_t images {16};
+    constexpr size_t body {64 << 10};
+    constexpr size_t chunk {16 << 10};
+    static size_t run {0};
+    double throttled_us {0};
+    auto const timing {measure(3, [&]{
+        Bandwidth budget;
+        std::atomic<uint64_t> waited {0};
+        FetchPool pool{workers, [&](std::string const &url, FetchPool::TCancelled const &cancelled) {
+            for (size_t received = 0; received < body && !cancelled(); received += chunk) {
+                auto const wait {budget.Take(chunk, bytes_per_second)};
+                waited += uint64_t(wait.count());
+                std::this_thread::sleep_for(wait);
+            }
+            return url;
+        }};
+        auto const prefix {"bandwidth" + std::to_string(run++) + "/"};
+        for (size_t i = 0; i < images; ++i) {
+            pool.Request(&pool, prefix + std::to_string(i), 0);
+        }
+        for (size_t taken {0}; taken < images;) {
+            taken += pool.Take(&pool).size();
+            std::this_thread::sleep_for(std::chrono::microseconds{100});
+        }
+        throttled_us = double(waited);
+    })};
+    emit("fetch_bandwidth", {{"bytes_per_second", double(bytes_per_second)}, {"workers", double(workers)}}, timing, {
+        {"achieved_bytes_per_second", images * body / (timing.mean_us / 1e6)},
+        {"throttled_us", throttled_us}
+    });
+}
+
+int main() {
+    jump(false);
+    jump(true);
+    scroll();
+    for (size_t const authors: {1, 5, 200}) {
+        dedup(authors);
+    }
+    for (size_t const workers: {1, 4}) {
+        bandwidth(4 << 20, workers);
+    }
+    return 0;
+}
@@ -0,0 +1,41 @@
+// Data document parse over megabyte-scale "$data" arrays, compact and indented. The Makefile
+// builds this twice, as bench/parse with the SIMD scanners it detected for the target and as
+// bench/parse-scalar without, so the two runs differ only in rapidjson's scanning code.
+#include <memory>
+#include <string>
+#include "../adaptivecards-core.h"
+#include "bench.h"
+#include "cardgen.h"
+
+using namespace AdaptiveCards;
+using namespace AdaptiveCards::Bench;
+
+int main() {
+    auto const benchmark {"data_parse_" + std::string{parser_simd()}};
+    for (size_t const rows: {1000, 4000, 16000}) {
+        for (bool const pretty: {false, true}) {
+            CorpusParams params;
+            params.elements = 10;
+            params.depth = 0;
+            params.images = 1;
+            params.rows = rows;
+            params.pretty = pretty;
+            auto const card {generate_card(params)};
+            size_t const iterations {rows >= 16000 ? 20u : 80u};
+            std::string source;
+            std::unique_ptr<Arena> arena;
+            size_t members {0};
+            // The previous arena is freed untimed, so only the scan and the DOM build count.
+            auto const parse {measure(iterations, [&]{ arena.reset(); source = card.data; }, [&]{
+                arena = std::make_unique<Arena>(std::move(source));
+                members += arena->doc().MemberCount();
+            })};
+            emit(benchmark.c_str(), {{"rows", double(rows)}, {"pretty", double(pretty)}}, parse, {
+                {"bytes", double(card.data.size())},
+                {"mb_per_s", double(card.data.size()) / parse.min_us},
+                {"members", double(members / iterations)}
+            });
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,91 @@
+// Headless benchmarks for next-card prefetch: navigation latency against a slow provider
+// with and without a prefetched card, and how quickly navigation cancels loads in flight.
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../adaptivecards-prefetch.h"
+#include "bench.h"
+#include "cardgen.h"
+
+using namespace AdaptiveCards;
+using namespace AdaptiveCards::Bench;
+
+constexpr std::chrono::milliseconds provider_latency {20};
+constexpr std::chrono::milliseconds think_time {50};
+
+static GeneratedCard corpus;
+
+static std::shared_ptr<Card> load(Prefetcher::TCancelled const &cancelled) {
+    std::this_thread::sleep_for(provider_latency);
+    if (cancelled()) {
+        return nullptr;
+    }
+    auto card {std::make_shared<Card>(std::string{corpus.card_template})};
+    card->SetData(std::string{corpus.data});
+    return card;
+}
+
+static void navigate(size_t elements, bool prefetch) {
+    CorpusParams params;
+    params.elements = elements;
+    corpus = generate_card(params);
+    Prefetcher prefetcher{2, 8 << 20, [](std::string const &, Prefetcher::TCancelled const &cancelled) {
+        auto card {load(cancelled)};
+        auto const bytes {card ? card->bytes() : 0};
+        return Prefetched{std::move(card), bytes};
+    }};
+    std::vector<std::string> const next {"next"};
+    auto const timing {measure(10, [&]{
+        if (prefetch) {
+            prefetcher.Request(next);
+        }
+        std::this_thread::sleep_for(think_time);
+    }, [&]{
+        auto card {prefetcher.Take("next")};
+        if (!card) {
+            card = load([]{ return false; });
+        }
+        prefetcher.Cancel();
+    })};
+    auto const stats {prefetcher.stats()};
+    emit("prefetch_navigate", {{"elements", double(elements)}, {"prefetch", prefetch ? 1.0 : 0.0}}, timing, {
+        {"hits", double(stats.hits)},
+        {"misses", double(stats.misses)}
+    });
+}
+
+static void cancel(size_t locators) {
+    corpus = generate_card({});
+    Prefetcher prefetcher{2, 8 << 20, [](std::string const &, Prefetcher::TCancelled const &cancelled) {
+        auto card {load(cancelled)};
+        return Prefetched{std::move(card), 0};
+    }};
+    std::vector<std::string> next;
+    for (size_t i = 0; i < locators; ++i) {
+        next.push_back("card" + std::to_string(i));
+    }
+    auto const timing {measure(10, [&]{
+        prefetcher.Request(next);
+        std::this_thread::sleep_for(provider_latency / 2);
+    }, [&]{
+        prefetcher.Cancel();
+    })};
+    prefetcher.Shutdown();
+    auto const stats {prefetcher.stats()};
+    emit("prefetch_cancel", {{"locators", double(locators)}}, timing, {
+        {"requested", double(stats.requested)},
+        {"completed", double(stats.completed)},
+        {"cancelled", double(stats.cancelled)}
+    });
+}
+
+int main() {
+    for (size_t const elements: {100, 1000}) {
+        navigate(elements, false);
+        navigate(elements, true);
+    }
+    cancel(8);
+    return 0;
+}
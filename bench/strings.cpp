@@ -0,0 +1,172 @@
+// Allocation counts for binding a card: the std::string based path this repo used
+// before the arena rework, against the Card/Arena path in adaptivecards-core.h.
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../adaptivecards-core.h"
+#include "bench.h"
+
+extern "C" void *__libc_malloc(size_t);
+extern "C" void *__libc_calloc(size_t, size_t);
+extern "C" void *__libc_realloc(void *, size_t);
+extern "C" void __libc_free(void *);
+
+static size_t allocations{0};
+static size_t allocated_bytes{0};
+
+extern "C" void *malloc(size_t size) { ++allocations; allocated_bytes += size; return __libc_malloc(size); }
+extern "C" void *calloc(size_t n, size_t size) { ++allocations; allocated_bytes += n * size; return __libc_calloc(n, size); }
+extern "C" void *realloc(void *p, size_t size) { ++allocations; allocated_bytes += size; return __libc_realloc(p, size); }
+extern "C" void free(void *p) { __libc_free(p); }
+
+static std::string read_file(const char *name) {
+    std::ifstream in{name};
+    return {std::istreambuf_iterator<char>{in}, std::istreambuf_iterator<char>{}};
+}
+
+namespace legacy
+{
+    using TSinks = std::vector<std::pair<std::string,std::function<void(std::string)>>>;
+
+    static auto split(std::string const &src, char delimiter = '.') {
+        std::stringstream ss(src);
+        std::vector<std::string> result;
+        std::string word;
+        while (std::getline(ss, word, delimiter)) {
+            result.push_back(word);
+        }
+        return result;
+    }
+
+    static void expr(TSinks &sinks, std::function<void(std::string)> setter, std::string const &text) {
+        std::smatch match_result;
+        static std::regex const match_expr {"\\$\\{(.+)\\}"};
+        if (std::regex_match(text, match_result, match_expr)) {
+            sinks.push_back(std::make_pair(match_result[1], setter));
+        }
+        else {
+            setter(text);
+        }
+    }
+
+    static void walk(rapidjson::Value &element, TSinks &sinks, std::vector<std::shared_ptr<std::string>> &widgets) {
+        for (auto const name: {"body", "columns", "items"}) {
+            if (element.HasMember(name)) {
+                for (auto &child: element[name].GetArray()) {
+                    walk(child, sinks, widgets);
+                }
+            }
+        }
+        for (auto const name: {"size", "weight", "url"}) {
+            if (element.HasMember(name)) {
+                expr(sinks, [](std::string) {}, element[name].GetString());
+            }
+        }
+        if (element.HasMember("text")) {
+            auto const text {std::string(element["text"].GetString())};
+            auto original_text {std::make_shared<std::string>(text)};
+            widgets.push_back(original_text);
+            expr(sinks, [original_text](std::string value) { *original_text = value; }, text);
+        }
+    }
+
+    static void bind(std::string const &card_template, std::string const &data) {
+        TSinks sinks;
+        std::vector<std::shared_ptr<std::string>> widgets;
+        rapidjson::Document doc;
+        doc.Parse(card_template.c_str());
+        walk(doc, sinks, widgets);
+        rapidjson::Document data_doc;
+        data_doc.Parse(data.c_str());
+        for (auto &sink: sinks) {
+            std::reference_wrapper<const rapidjson::Value> last_value{data_doc};
+            for(std::string const &member: split(sink.first)) {
+                auto o {last_value.get().GetObject()};
+                last_value = std::cref(o[member.c_str()]);
+            }
+            sink.second(last_value.get().GetString());
+        }
+    }
+}
+
+namespace arena
+{
+    using TSetter = std::function<void(std::string_view)>;
+    using TSinks = std::vector<std::pair<std::string_view,TSetter>>;
+
+    static void expr(TSinks &sinks, TSetter setter, std::string_view text) {
+        auto const path {AdaptiveCards::binding_path(text)};
+        if (!path.empty()) {
+            sinks.emplace_back(path, std::move(setter));
+        }
+        else {
+            setter(text);
+        }
+    }
+
+    static void walk(rapidjson::Value &element, TSinks &sinks, std::vector<std::shared_ptr<std::string_view>> &widgets) {
+        for (auto const name: {"body", "columns", "items"}) {
+            auto const pos {element.FindMember(name)};
+            if (pos != element.MemberEnd()) {
+                for (auto &child: pos->value.GetArray()) {
+                    walk(child, sinks, widgets);
+                }
+            }
+        }
+        for (auto const name: {"size", "weight", "url"}) {
+            if (element.HasMember(name)) {
+                expr(sinks, [](std::string_view) {}, AdaptiveCards::member_view(element, name));
+            }
+        }
+        if (element.HasMember("text")) {
+            auto const text {AdaptiveCards::member_view(element, "text")};
+            auto original_text {std::make_shared<std::string_view>(text)};
+            widgets.push_back(original_text);
+            expr(sinks, [original_text](std::string_view value) { *original_text = value; }, text);
+        }
+    }
+
+    static void bind(std::string &&card_template, std::string &&data) {
+        TSinks sinks;
+        std::vector<std::shared_ptr<std::string_view>> widgets;
+        auto card {std::make_shared<AdaptiveCards::Card>(std::move(card_template))};
+        walk(card->doc(), sinks, widgets);
+        card->SetData(std::move(data));
+        for (auto &sink: sinks) {
+            auto const value {AdaptiveCards::resolve(card->data(), sink.first)};
+            sink.second(value ? AdaptiveCards::view(*value) : std::string_view{});
+        }
+    }
+}
+
+int main() {
+    auto const card_template {read_file("card_template1.json")};
+    auto const data {read_file("card1.json")};
+    size_t const rounds {1000};
+
+    auto const run = [&](const char *benchmark, auto &&bind) {
+        std::string t, d;
+        size_t count {0}, bytes {0};
+        auto const timing {AdaptiveCards::Bench::measure(rounds, [&]{ t = card_template; d = data; }, [&]{
+            auto const before_count {allocations};
+            auto const before_bytes {allocated_bytes};
+            bind(std::move(t), std::move(d));
+            count += allocations - before_count;
+            bytes += allocated_bytes - before_bytes;
+        })};
+        AdaptiveCards::Bench::emit(benchmark, {}, timing, {
+            {"allocations", double(count) / rounds},
+            {"bytes", double(bytes) / rounds}
+        });
+    };
+    run("bind_allocations_before", [](std::string &&t, std::string &&d) { legacy::bind(t, d); });
+    run("bind_allocations_after", [](std::string &&t, std::string &&d) { arena::bind(std::move(t), std::move(d)); });
+    return 0;
+}
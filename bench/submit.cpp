@@ -0,0 +1,67 @@
+// Headless benchmarks for the Action.Submit pipeline: payload serialization and a burst of
+// submits against a slow sink.
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../adaptivecards-submit.h"
+#include "bench.h"
+
+using namespace AdaptiveCards;
+using namespace AdaptiveCards::Bench;
+
+static void serialize(size_t count) {
+    std::vector<std::string> ids;
+    for (size_t i = 0; i < count; ++i) {
+        ids.push_back("input" + std::to_string(i));
+    }
+    TInputValues inputs;
+    for (auto const &id: ids) {
+        inputs.emplace_back(id, "value of " + id);
+    }
+    Arena data{std::string_view{R"({"action": "save", "card": 42, "input0": "shadowed"})"}};
+    size_t bytes {0};
+    auto const timing {measure(1000, [&]{
+        bytes = SerializeSubmit(&data.doc(), inputs).size();
+    })};
+    emit("submit_serialize", {{"inputs", double(count)}}, timing, {{"bytes", double(bytes)}});
+}
+
+static void burst(size_t actions, size_t clicks) {
+    SubmitQueue queue{[](std::string_view, std::string_view) {
+        std::this_thread::sleep_for(std::chrono::milliseconds{2});
+    }};
+    std::vector<std::string> names;
+    for (size_t i = 0; i < actions; ++i) {
+        names.push_back("action" + std::to_string(i));
+    }
+    size_t click {0};
+    auto const timing {measure(clicks, [&]{
+        queue.Submit(names[click++ % actions], std::string{R"({"comment":"hello"})"});
+    })};
+    queue.Shutdown();
+    SubmitStats total;
+    for (auto const &action: queue.stats()) {
+        total.coalesced += action.second.coalesced;
+        total.completed += action.second.completed;
+        total.total_ns += action.second.total_ns;
+        total.max_ns = std::max(total.max_ns, action.second.max_ns);
+    }
+    emit("submit_burst", {{"actions", double(actions)}, {"clicks", double(clicks)}}, timing, {
+        {"coalesced", double(total.coalesced)},
+        {"delivered", double(total.completed)},
+        {"max_depth", double(queue.max_depth())},
+        {"mean_latency_us", total.completed ? total.total_ns / 1000.0 / total.completed : 0.0},
+        {"max_latency_us", total.max_ns / 1000.0}
+    });
+}
+
+int main() {
+    for (size_t const count: {10, 100}) {
+        serialize(count);
+    }
+    for (size_t const actions: {1, 4}) {
+        burst(actions, 1000);
+    }
+    return 0;
+}
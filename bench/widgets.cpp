@@ -0,0 +1,228 @@
+// Widget creation and resize relayout over the synthetic corpus, the resampler against
+// wxImage's own scaling, and a gallery as one ImageSet against separate Image elements. Needs a display; `make bench-wx` runs it under xvfb-run when one
+// is available.
+#define ADAPTIVECARDS_RENDER_STATS
+#include <wx/filename.h>
+#include "../adaptivecards-wx.h"
+#include "bench.h"
+#include "cardgen.h"
+
+using namespace AdaptiveCards::Bench;
+
+// Prefetch workers call this too, so the card is swapped under a lock.
+struct CorpusProvider {
+    static inline std::mutex mutex;
+    static inline GeneratedCard card;
+
+    static void Set(GeneratedCard next) {
+        std::lock_guard<std::mutex> lock{mutex};
+        card = std::move(next);
+    }
+
+    std::pair<std::string, std::string> operator()(std::string_view, std::string_view) {
+        std::lock_guard<std::mutex> lock{mutex};
+        return {card.card_template, card.data};
+    }
+};
+
+constexpr char initial_card[] {"/"};
+
+// The same pixels as an RgbaImage and as a wxImage with alpha.
+static std::pair<AdaptiveCards::RgbaImage, wxImage> gradient(int width, int height) {
+    AdaptiveCards::RgbaImage rgba{width, height};
+    for (int y = 0; y < height; ++y) {
+        auto out {rgba.row(y)};
+        for (int x = 0; x < width; ++x, out += 4) {
+            out[0] = uint8_t(x * 255 / width);
+            out[1] = uint8_t(y * 255 / height);
+            out[2] = uint8_t((x ^ y) & 0xFF);
+            out[3] = 0xFF;
+        }
+    }
+    return {rgba, AdaptiveCards::ToWxImage(rgba)};
+}
+
+// Resample() with each filter and instruction set, then wxImage::Scale() at
+// wxIMAGE_QUALITY_NORMAL (nearest neighbour) and wxIMAGE_QUALITY_HIGH (box average when
+// shrinking), all ending in a wxImage ready for a bitmap.
+static void resample_against_wx() {
+    using AdaptiveCards::ResampleFilter;
+    using AdaptiveCards::SimdLevel;
+    for (auto const &source: {gradient(1000, 750), gradient(4000, 3000)}) {
+        for (int const target: {75, 250}) {
+            auto const height {source.first.height * target / source.first.width};
+            TParams const config {
+                {"source_width", double(source.first.width)},
+                {"target_width", double(target)}
+            };
+            for (auto const filter: {ResampleFilter::Bilinear, ResampleFilter::Lanczos3}) {
+                for (auto const level: {SimdLevel::Scalar, SimdLevel::Sse2, SimdLevel::Avx2}) {
+                    if (level > AdaptiveCards::simd_level()) {
+                        continue;
+                    }
+                    auto const timing {measure(5, [&]{
+                        AdaptiveCards::ToWxImage(AdaptiveCards::Resample(source.first, target, height, filter, level));
+                    })};
+                    auto params {config};
+                    params.push_back({"lanczos", filter == ResampleFilter::Lanczos3 ? 1.0 : 0.0});
+                    params.push_back({"simd", double(level)});
+                    emit("resample_vs_wx", params, timing);
+                }
+            }
+            for (auto const quality: {wxIMAGE_QUALITY_NORMAL, wxIMAGE_QUALITY_HIGH}) {
+                auto const timing {measure(5, [&]{
+                    source.second.Scale(target, height, quality);
+                })};
+                auto params {config};
+                params.push_back({"wx_quality_high", quality == wxIMAGE_QUALITY_HIGH ? 1.0 : 0.0});
+                emit("resample_vs_wx", params, timing);
+            }
+        }
+    }
+}
+
+static size_t count_windows(wxWindow *window) {
+    size_t count {1};
+    for (auto const child: window->GetChildren()) {
+        count += count_windows(child);
+    }
+    return count;
+}
+
+// `thumbnails` images through a "$data" ImageSet, or as that many Image elements.
+static GeneratedCard gallery(size_t thumbnails, std::string const &url, bool image_set) {
+    GeneratedCard card;
+    card.data = "{\"photos\":[";
+    for (size_t i = 0; i < thumbnails; ++i) {
+        card.data += (i ? ",{\"url\":\"" : "{\"url\":\"") + url + "\"}";
+    }
+    card.data += "]}";
+    auto const image {R"({"type":"Image","size":"Small","$data":"${photos}","url":"${url}"})"};
+    card.card_template = std::string{R"({"type":"AdaptiveCard","version":"1.0","body":[)"}
+        + (image_set ? std::string{R"({"type":"ImageSet","imageSize":"Small","images":[)"} + image + "]}" : std::string{image})
+        + "]}";
+    return card;
+}
+
+class BenchApp : public AdaptiveCards::App<CorpusProvider, initial_card> {
+    void RunImageSet(AdaptiveCards::Frame *frame, std::string const &url) {
+        for (size_t const thumbnails: {100, 400}) {
+            for (bool const image_set: {false, true}) {
+                CorpusProvider::Set(gallery(thumbnails, url, image_set));
+                size_t windows {0};
+                auto const timing {measure(5, [&]{
+                    ShowCard(initial_card, "{}", frame);
+                    auto const panel {card_panel()};
+                    while (!panel->queue().complete()) {
+                        wxIdleEvent idle;
+                        panel->ProcessWindowEvent(idle);
+                    }
+                    frame->Update();
+                    windows = count_windows(panel);
+                })};
+                emit("image_gallery", {
+                    {"thumbnails", double(thumbnails)},
+                    {"image_set", image_set ? 1.0 : 0.0}
+                }, timing, {
+                    {"windows", double(windows)}
+                });
+            }
+        }
+    }
+
+    void RunBenchmarks() {
+        resample_against_wx();
+        auto const image_path {wxFileName::GetTempDir() + "/adaptivecards-bench.png"};
+        wxImage{256, 256}.SaveFile(image_path, wxBITMAP_TYPE_PNG);
+        auto frame {new AdaptiveCards::Frame("bench", wxPoint(0, 0), wxSize(800, 600))};
+        frame->Show(true);
+        RunImageSet(frame, "file://" + image_path.ToStdString());
+        for (size_t const elements: {10, 100, 500}) {
+            for (size_t const depth: {0, 3}) {
+                CorpusParams params;
+                params.elements = elements;
+                params.depth = depth;
+                params.images = elements / 20;
+                params.image_url = "file://" + image_path.ToStdString();
+                CorpusProvider::Set(generate_card(params));
+                TParams const config {
+                    {"elements", double(params.elements)},
+                    {"depth", double(params.depth)},
+                    {"binding_density", params.binding_density},
+                    {"images", double(params.images)}
+                };
+                size_t const iterations {elements >= 500 ? 5u : 20u};
+
+                AdaptiveCards::RenderStats created{};
+                auto const create {measure(iterations, [&]{
+                    ShowCard(initial_card, "{}", frame);
+                    frame->Update();
+                    created = AdaptiveCards::render_stats();
+                })};
+                emit("widget_creation", config, create, {
+                    {"paints", double(created.paints)},
+                    {"layouts", double(created.layouts)}
+                });
+
+                // Idle events delivered directly, so the slices run back to back.
+                AdaptiveCards::ProgressStats progress{};
+                auto const progressive {measure(iterations, [&]{
+                    ShowCard(initial_card, "{}", frame);
+                    frame->Update();
+                    auto const panel {card_panel()};
+                    while (!panel->queue().complete()) {
+                        wxIdleEvent idle;
+                        panel->ProcessWindowEvent(idle);
+                        frame->Update();
+                    }
+                    progress = panel->queue().stats();
+                })};
+                emit("progressive_render", config, progressive, {
+                    {"first_paint_us", progress.first_paint_us},
+                    {"complete_us", progress.complete_us},
+                    {"tasks", double(progress.tasks)},
+                    {"slices", double(progress.slices)},
+                    {"max_slice_us", progress.max_slice_us}
+                });
+
+                auto const restore {measure(iterations, [&]{
+                    Back(frame);
+                    frame->Update();
+                    Forward(frame);
+                    frame->Update();
+                })};
+                emit("history_restore", config, restore, {
+                    {"restores", 2},
+                    {"live_cards", double(history().live())},
+                    {"live_bytes", double(history().live_bytes())}
+                });
+
+                int width {800};
+                AdaptiveCards::render_stats() = {};
+                auto const relayout {measure(iterations, [&]{
+                    width = width == 800 ? 640 : 800;
+                    frame->SetSize(width, 600);
+                    frame->Update();
+                })};
+                emit("resize_relayout", config, relayout, {
+                    {"paints", double(AdaptiveCards::render_stats().paints) / iterations},
+                    {"layouts", double(AdaptiveCards::render_stats().layouts) / iterations}
+                });
+            }
+        }
+        frame->Destroy();
+        ExitMainLoop();
+    }
+
+public:
+    bool OnInit() override {
+        CorpusProvider::Set(generate_card({}));
+        if (!App::OnInit()) {
+            return false;
+        }
+        CallAfter([this]{ RunBenchmarks(); });
+        return true;
+    }
+};
+
+wxIMPLEMENT_APP(BenchApp);
@@ -1,12 +1,16 @@
 #include <utility>
 #include <string>
+#include <string_view>
+#include <sstream>
 #include <fstream>
 #include <iterator>
 
+// This program's one definition of the allocation-tracking operator new and delete.
+#define ADAPTIVECARDS_ALLOC_TRACKING_IMPL
 #include "adaptivecards-wx.h"
 
 struct CardsProvider {
-    std::pair<std::string, std::string> operator()(std::string const &card_locator, std::string const &posted_data) {
+    std::pair<std::string, std::string> operator()(std::string_view card_locator, std::string_view posted_data) {
         std::stringstream card_template;
         {
             std::ifstream template1{"card_template1.json"};